@@ -1,8 +1,149 @@
-#include "bigint.h"
+#include "bigint_kern.h"
 
-#include "strbuf.h"
 #include "string.h"
 
+#if defined(BINT_BLK_64) && defined(__BMI2__) && defined(__ADX__)
+#include <immintrin.h>
+#define BINT_USE_MULX
+#endif
+
+static void* _bint_default_alloc(size_t size) { return malloc(size); }
+
+static void* _bint_default_realloc(void* p, size_t old_size,
+                                   size_t new_size) {
+    (void)old_size;
+    return realloc(p, new_size);
+}
+
+static void _bint_default_free(void* p, size_t size) {
+    (void)size;
+    free(p);
+}
+
+static bint_alloc_fn _bint_alloc_func = _bint_default_alloc;
+static bint_realloc_fn _bint_realloc_func = _bint_default_realloc;
+static bint_free_fn _bint_free_func = _bint_default_free;
+
+void BINT_set_memory_functions(bint_alloc_fn alloc, bint_realloc_fn realloc,
+                               bint_free_fn free) {
+    _bint_alloc_func = alloc ? alloc : _bint_default_alloc;
+    _bint_realloc_func = realloc ? realloc : _bint_default_realloc;
+    _bint_free_func = free ? free : _bint_default_free;
+}
+
+void BINT_get_memory_functions(bint_alloc_fn* alloc, bint_realloc_fn* realloc,
+                               bint_free_fn* free) {
+    if (alloc) *alloc = _bint_alloc_func;
+    if (realloc) *realloc = _bint_realloc_func;
+    if (free) *free = _bint_free_func;
+}
+
+void* _bint_alloc(size_t size) { return _bint_alloc_func(size); }
+
+void* _bint_realloc(void* p, size_t old_size, size_t new_size) {
+    return _bint_realloc_func(p, old_size, new_size);
+}
+
+void _bint_free(void* p, size_t size) { _bint_free_func(p, size); }
+
+#define BINT_TMP_ALIGN 64
+
+// Under AddressSanitizer the free part of the arena is poisoned, and every
+// allocation is followed by a poisoned red zone, so overruns of temporaries
+// are still caught.
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/asan_interface.h>
+#define BINT_TMP_REDZONE BINT_TMP_ALIGN
+#define BINT_TMP_POISON(p, n) ASAN_POISON_MEMORY_REGION(p, n)
+#define BINT_TMP_UNPOISON(p, n) ASAN_UNPOISON_MEMORY_REGION(p, n)
+#else
+#define BINT_TMP_REDZONE 0
+#define BINT_TMP_POISON(p, n) ((void)(p), (void)(n))
+#define BINT_TMP_UNPOISON(p, n) ((void)(p), (void)(n))
+#endif
+
+/// A chunk of the scratch arena. The memory follows the header, which is
+/// padded to BINT_TMP_ALIGN.
+typedef struct _bint_tmp_chunk {
+    struct _bint_tmp_chunk* prev; /* the chunk below */
+    size_t prev_top;              /* bytes used in prev when this was pushed */
+    size_t size;                  /* usable bytes */
+} _bint_tmp_chunk;
+
+static _Thread_local struct {
+    _bint_tmp_chunk* cur;   /* chunk being bumped, NULL if none */
+    size_t top;             /* bytes used in cur */
+    _bint_tmp_chunk* spare; /* largest released chunk, kept for reuse */
+} _bint_tmp;
+
+_bint_tmp_pos _bint_tmp_mark(void) {
+    _bint_tmp_pos pos = {_bint_tmp.cur, _bint_tmp.top};
+    return pos;
+}
+
+void* _bint_tmp_alloc(size_t size) {
+    size_t req = size;
+    size = (size + BINT_TMP_ALIGN - 1) & ~(size_t)(BINT_TMP_ALIGN - 1);
+    size += BINT_TMP_REDZONE;
+    _bint_tmp_chunk* c = _bint_tmp.cur;
+    if (!c || _bint_tmp.top + size > c->size) {
+        if (_bint_tmp.spare && _bint_tmp.spare->size >= size) {
+            c = _bint_tmp.spare;
+            _bint_tmp.spare = NULL;
+        } else {
+            size_t sz = _bint_tmp.cur ? 2 * _bint_tmp.cur->size
+                                      : BINT_TMP_CHUNK_SZ;
+            sz = MAX(sz, size);
+            c = (_bint_tmp_chunk*)_bint_alloc(BINT_TMP_ALIGN + sz);
+            if (!c) return NULL;
+            c->size = sz;
+            BINT_TMP_POISON((char*)c + BINT_TMP_ALIGN, sz);
+        }
+        c->prev = _bint_tmp.cur;
+        c->prev_top = _bint_tmp.top;
+        _bint_tmp.cur = c;
+        _bint_tmp.top = 0;
+    }
+    void* p = (char*)c + BINT_TMP_ALIGN + _bint_tmp.top;
+    _bint_tmp.top += size;
+    BINT_TMP_UNPOISON(p, req);
+    return p;
+}
+
+void _bint_tmp_release(_bint_tmp_pos pos) {
+    while (_bint_tmp.cur != pos.chunk) {
+        _bint_tmp_chunk* c = _bint_tmp.cur;
+        _bint_tmp.cur = c->prev;
+        _bint_tmp.top = c->prev_top;
+        if (!_bint_tmp.spare || c->size > _bint_tmp.spare->size) {
+            _bint_tmp_chunk* t = _bint_tmp.spare;
+            _bint_tmp.spare = c;
+            BINT_TMP_POISON((char*)c + BINT_TMP_ALIGN, c->size);
+            c = t;
+        }
+        if (c) {
+            BINT_TMP_UNPOISON((char*)c + BINT_TMP_ALIGN, c->size);
+            _bint_free(c, BINT_TMP_ALIGN + c->size);
+        }
+    }
+    _bint_tmp.top = pos.top;
+    if (_bint_tmp.cur) {
+        BINT_TMP_POISON((char*)_bint_tmp.cur + BINT_TMP_ALIGN + pos.top,
+                        _bint_tmp.cur->size - pos.top);
+    }
+}
+
+void BINT_free_scratch(void) {
+    _bint_tmp_pos empty = {NULL, 0};
+    _bint_tmp_release(empty);
+    if (_bint_tmp.spare) {
+        BINT_TMP_UNPOISON((char*)_bint_tmp.spare + BINT_TMP_ALIGN,
+                          _bint_tmp.spare->size);
+        _bint_free(_bint_tmp.spare, BINT_TMP_ALIGN + _bint_tmp.spare->size);
+        _bint_tmp.spare = NULL;
+    }
+}
+
 uint32_t _bint_10_exp(int x) {
     switch (x) {
         case 0:
@@ -29,162 +170,686 @@ uint32_t _bint_10_exp(int x) {
     return 1;
 }
 
+static inline size_t _bint_normlen(const bint_blk_type* p, size_t n) {
+    while (n > 0 && p[n - 1] == 0) n--;
+    return n;
+}
+
+static inline int _bint_cmp_n(const bint_blk_type* ap, const bint_blk_type* bp,
+                              size_t n) {
+    for (size_t i = n - 1; i + 1; i--) {
+        if (ap[i] != bp[i]) return ap[i] > bp[i] ? 1 : -1;
+    }
+    return 0;
+}
+
+/// rp = ap + b over n blocks. Returns the carry out.
+static inline bint_blk_type _bint_add_1(bint_blk_type* rp,
+                                        const bint_blk_type* ap, size_t n,
+                                        bint_blk_type b) {
+    size_t i = 0;
+    for (; i < n && b; i++) {
+        rp[i] = ap[i] + b;
+        b = rp[i] < b;
+    }
+    if (rp != ap) {
+        for (; i < n; i++) rp[i] = ap[i];
+    }
+    return b;
+}
+
+/// rp = ap - b over n blocks. Returns the borrow out.
+static inline bint_blk_type _bint_sub_1(bint_blk_type* rp,
+                                        const bint_blk_type* ap, size_t n,
+                                        bint_blk_type b) {
+    size_t i = 0;
+    bint_blk_type a;
+    for (; i < n && b; i++) {
+        a = ap[i];
+        rp[i] = a - b;
+        b = a < b;
+    }
+    if (rp != ap) {
+        for (; i < n; i++) rp[i] = ap[i];
+    }
+    return b;
+}
+
+static bint_blk_type _bint_add_n_scalar(bint_blk_type* rp,
+                                        const bint_blk_type* ap,
+                                        const bint_blk_type* bp, size_t n) {
+#ifdef BINT_USE_MULX
+    unsigned char c = 0;
+    for (size_t i = 0; i < n; i++) {
+        c = _addcarryx_u64(c, ap[i], bp[i], (unsigned long long*)(rp + i));
+    }
+    return c;
+#else
+    bint_blk_type carry = 0;
+    bint_dblk_type tmp;
+    for (size_t i = 0; i < n; i++) {
+        tmp = (bint_dblk_type)ap[i] + bp[i] + carry;
+        carry = tmp >> BINT_BLK_BIT_SZ;
+        rp[i] = (bint_blk_type)tmp;
+    }
+    return carry;
+#endif
+}
+
+static bint_blk_type _bint_sub_n(bint_blk_type* rp, const bint_blk_type* ap,
+                                 const bint_blk_type* bp, size_t n) {
+#ifdef BINT_USE_MULX
+    unsigned char b = 0;
+    for (size_t i = 0; i < n; i++) {
+        b = _subborrow_u64(b, ap[i], bp[i], (unsigned long long*)(rp + i));
+    }
+    return b;
+#else
+    bint_blk_type borrow = 0;
+    bint_dblk_type tmp;
+    for (size_t i = 0; i < n; i++) {
+        tmp = (bint_dblk_type)ap[i] - bp[i] - borrow;
+        borrow = (tmp >> BINT_BLK_BIT_SZ) & 1;
+        rp[i] = (bint_blk_type)tmp;
+    }
+    return borrow;
+#endif
+}
+
+/// Shift ap[0..n) left by 0 < cnt < BINT_BLK_BIT_SZ bits into rp.
+/// Returns the bits shifted out.
+static bint_blk_type _bint_lshift_scalar(bint_blk_type* rp,
+                                         const bint_blk_type* ap, size_t n,
+                                         unsigned cnt) {
+    bint_blk_type out = ap[n - 1] >> (BINT_BLK_BIT_SZ - cnt);
+    for (size_t i = n - 1; i > 0; i--) {
+        rp[i] = (ap[i] << cnt) | (ap[i - 1] >> (BINT_BLK_BIT_SZ - cnt));
+    }
+    rp[0] = ap[0] << cnt;
+    return out;
+}
+
+/// Shift ap[0..n) right by 0 < cnt < BINT_BLK_BIT_SZ bits into rp.
+/// Returns the bits shifted out, in the high end of a block.
+static bint_blk_type _bint_rshift_scalar(bint_blk_type* rp,
+                                         const bint_blk_type* ap, size_t n,
+                                         unsigned cnt) {
+    bint_blk_type out = ap[0] << (BINT_BLK_BIT_SZ - cnt);
+    for (size_t i = 0; i + 1 < n; i++) {
+        rp[i] = (ap[i] >> cnt) | (ap[i + 1] << (BINT_BLK_BIT_SZ - cnt));
+    }
+    rp[n - 1] = ap[n - 1] >> cnt;
+    return out;
+}
+
+static bint_blk_type _bint_addmul_1_scalar(bint_blk_type* rp,
+                                           const bint_blk_type* ap, size_t n,
+                                           bint_blk_type m) {
+    bint_blk_type carry = 0;
+    bint_dblk_type tmp;
+    for (size_t i = 0; i < n; i++) {
+        tmp = (bint_dblk_type)ap[i] * m + rp[i] + carry;
+        carry = tmp >> BINT_BLK_BIT_SZ;
+        rp[i] = (bint_blk_type)tmp;
+    }
+    return carry;
+}
+
+static void _bint_mul_basecase_scalar(bint_blk_type* rp,
+                                      const bint_blk_type* ap, size_t an,
+                                      const bint_blk_type* bp, size_t bn);
+static void _bint_soa_add_scalar(uint64_t* rp, size_t rl, const uint64_t* ap,
+                                 size_t al, const uint64_t* bp, size_t bl,
+                                 size_t stride);
+static void _bint_soa_mul_scalar(uint64_t* rp, size_t rl, const uint64_t* ap,
+                                 size_t al, const uint64_t* bp, size_t bl,
+                                 size_t stride);
+static void _bint_soa_montmul_scalar(uint64_t* rp, const uint64_t* ap,
+                                     const uint64_t* bp, const uint64_t* mp,
+                                     const uint64_t* mi, size_t n,
+                                     size_t stride);
+static void _bint_to_hex_scalar(char* out, const bint_blk_type* ap,
+                                size_t n);
+static int _bint_from_hex_scalar(bint_blk_type* rp, const char* s, size_t n);
+
+_bint_kernels _bint_kern = {
+    _bint_add_n_scalar,
+    _bint_lshift_scalar,
+    _bint_rshift_scalar,
+    _bint_addmul_1_scalar,
+    _bint_mul_basecase_scalar,
+    BINT_MUL_KARATSUBA_THRESHOLD,
+    BINT_SQR_KARATSUBA_THRESHOLD,
+    BINT_SQR_KARATSUBA_THRESHOLD,
+    BINT_POWMOD_REDC_THRESHOLD,
+    _bint_soa_add_scalar,
+    _bint_soa_mul_scalar,
+    _bint_soa_montmul_scalar,
+    _bint_to_hex_scalar,
+    _bint_from_hex_scalar,
+};
+
+#ifdef __GNUC__
+/// Picks the kernels for the running CPU. Runs once, when the library is
+/// loaded; until then (and without GCC) the scalar kernels are used.
+__attribute__((constructor)) static void _bint_kern_init(void) {
+#ifdef BINT_HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        _bint_kern.add_n = _bint_add_n_avx2;
+        _bint_kern.lshift = _bint_lshift_avx2;
+        _bint_kern.rshift = _bint_rshift_avx2;
+        _bint_kern.soa_add = _bint_soa_add_avx2;
+        _bint_kern.soa_mul = _bint_soa_mul_avx2;
+        _bint_kern.soa_montmul = _bint_soa_montmul_avx2;
+        _bint_kern.to_hex = _bint_to_hex_avx2;
+        _bint_kern.from_hex = _bint_from_hex_avx2;
+#ifndef BINT_BLK_64
+        _bint_kern.addmul_1 = _bint_addmul_1_avx2;
+        _bint_kern.mul_basecase = _bint_mul_basecase_avx2;
+        _bint_kern.redc_threshold = BINT_POWMOD_REDC_THRESHOLD_SIMD;
+#endif
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+        _bint_kern.add_n = _bint_add_n_avx512;
+        _bint_kern.lshift = _bint_lshift_avx512;
+        _bint_kern.rshift = _bint_rshift_avx512;
+        _bint_kern.soa_add = _bint_soa_add_avx512;
+        _bint_kern.soa_mul = _bint_soa_mul_avx512;
+        _bint_kern.soa_montmul = _bint_soa_montmul_avx512;
+#ifndef BINT_BLK_64
+        _bint_kern.addmul_1 = _bint_addmul_1_avx512;
+        _bint_kern.mul_basecase = _bint_mul_basecase_avx512;
+        _bint_kern.redc_threshold = BINT_POWMOD_REDC_THRESHOLD_SIMD;
+#endif
+    }
+    if (__builtin_cpu_supports("avx512ifma")) {
+        _bint_kern.mul_basecase = _bint_mul_basecase_ifma;
+        _bint_kern.karatsuba_threshold = BINT_MUL_KARATSUBA_THRESHOLD_IFMA;
+        _bint_kern.redc_threshold = BINT_POWMOD_REDC_THRESHOLD_SIMD;
+    }
+    if (_bint_kern.mul_basecase != _bint_mul_basecase_scalar) {
+        _bint_kern.sqr_karatsuba_threshold = _bint_kern.karatsuba_threshold;
+        _bint_kern.sqr_basecase_threshold = BINT_SQR_BASECASE_THRESHOLD_SIMD;
+    }
+#endif
+}
+#endif
+
+static inline bint_blk_type _bint_add_n(bint_blk_type* rp,
+                                        const bint_blk_type* ap,
+                                        const bint_blk_type* bp, size_t n) {
+    return _bint_kern.add_n(rp, ap, bp, n);
+}
+
+static inline bint_blk_type _bint_lshift(bint_blk_type* rp,
+                                         const bint_blk_type* ap, size_t n,
+                                         unsigned cnt) {
+    return _bint_kern.lshift(rp, ap, n, cnt);
+}
+
+static inline bint_blk_type _bint_rshift(bint_blk_type* rp,
+                                         const bint_blk_type* ap, size_t n,
+                                         unsigned cnt) {
+    return _bint_kern.rshift(rp, ap, n, cnt);
+}
+
+static inline bint_blk_type _bint_addmul_1(bint_blk_type* rp,
+                                           const bint_blk_type* ap, size_t n,
+                                           bint_blk_type m) {
+    return _bint_kern.addmul_1(rp, ap, n, m);
+}
+
+static inline void _bint_mul_basecase(bint_blk_type* rp,
+                                      const bint_blk_type* ap, size_t an,
+                                      const bint_blk_type* bp, size_t bn) {
+    _bint_kern.mul_basecase(rp, ap, an, bp, bn);
+}
+
+/// rp[0..an) = ap[0..an) + bp[0..bn), an >= bn. Returns the carry out.
+static inline bint_blk_type _bint_add(bint_blk_type* rp,
+                                      const bint_blk_type* ap, size_t an,
+                                      const bint_blk_type* bp, size_t bn) {
+    bint_blk_type carry = _bint_add_n(rp, ap, bp, bn);
+    return _bint_add_1(rp + bn, ap + bn, an - bn, carry);
+}
+
+/// rp[0..an) = ap[0..an) - bp[0..bn), an >= bn. Returns the borrow out.
+static inline bint_blk_type _bint_sub(bint_blk_type* rp,
+                                      const bint_blk_type* ap, size_t an,
+                                      const bint_blk_type* bp, size_t bn) {
+    bint_blk_type borrow = _bint_sub_n(rp, ap, bp, bn);
+    return _bint_sub_1(rp + bn, ap + bn, an - bn, borrow);
+}
+
+/// rp[0..an) = |ap - bp| for an >= bn. Returns 1 if ap < bp, 0 otherwise.
+static int _bint_absdiff(bint_blk_type* rp, const bint_blk_type* ap, size_t an,
+                         const bint_blk_type* bp, size_t bn) {
+    if (_bint_normlen(ap + bn, an - bn) || _bint_cmp_n(ap, bp, bn) >= 0) {
+        _bint_sub(rp, ap, an, bp, bn);
+        return 0;
+    }
+    _bint_sub_n(rp, bp, ap, bn);
+    memset(rp + bn, 0, BINT_BLK_SZ * (an - bn));
+    return 1;
+}
+
+/// Adds cp[0..cn) into rp[0..rn). The sum is known to fit in rn blocks.
+static inline void _bint_add_at(bint_blk_type* rp, size_t rn,
+                                const bint_blk_type* cp, size_t cn) {
+    cn = _bint_normlen(cp, cn);
+    _bint_add(rp, rp, rn, cp, cn);
+}
+
+/// The reciprocal of a normalized d (top bit set), floor((B^2 - 1) / d) - B
+/// for B = 2^BINT_BLK_BIT_SZ, which turns division by d into
+/// multiplications (Moller and Granlund, "Improved division by invariant
+/// integers").
+static inline bint_blk_type _bint_invert_limb(bint_blk_type d) {
+    bint_dblk_type num =
+        ((bint_dblk_type)(BINT_BLK_MAX - d) << BINT_BLK_BIT_SZ) | BINT_BLK_MAX;
+    return (bint_blk_type)(num / d);
+}
+
+/// Divides u1:u0 by the normalized d, for u1 < d, with v its reciprocal.
+/// Returns the quotient and leaves the remainder in *r.
+static inline bint_blk_type _bint_div_2by1(bint_blk_type* r, bint_blk_type u1,
+                                           bint_blk_type u0, bint_blk_type d,
+                                           bint_blk_type v) {
+    bint_dblk_type q = (bint_dblk_type)v * u1 +
+                       (((bint_dblk_type)u1 << BINT_BLK_BIT_SZ) | u0);
+    bint_blk_type q1 = (bint_blk_type)(q >> BINT_BLK_BIT_SZ) + 1;
+    bint_blk_type q0 = (bint_blk_type)q;
+    bint_blk_type rr = u0 - q1 * d;
+    // taken about half the time, so done with a mask instead of a branch
+    bint_blk_type mask = -(bint_blk_type)(rr > q0);
+    q1 += mask;
+    rr += mask & d;
+    if (rr >= d) {
+        q1++;
+        rr -= d;
+    }
+    *r = rr;
+    return q1;
+}
+
+/// qp[0..n) = ap[0..n) / d, for d != 0. Returns the remainder. qp may be
+/// ap, or NULL to only get the remainder. d is normalized and ap shifted
+/// along with it on the fly, and there are no divisions in the loop.
+static bint_blk_type _bint_divrem_1(bint_blk_type* qp, const bint_blk_type* ap,
+                                    size_t n, bint_blk_type d) {
+    if (!n) return 0;
+    unsigned s = BINT_CLZ(d), t = BINT_BLK_BIT_SZ - s;
+    d <<= s;
+    bint_blk_type v = _bint_invert_limb(d), r, q, hi, lo;
+    if (!s) {
+        r = 0;
+        for (size_t i = n - 1; i + 1; i--) {
+            q = _bint_div_2by1(&r, r, ap[i], d, v);
+            if (qp) qp[i] = q;
+        }
+        return r;
+    }
+    hi = ap[n - 1];
+    r = hi >> t;
+    for (size_t i = n - 1; i > 0; i--) {
+        lo = ap[i - 1];
+        q = _bint_div_2by1(&r, r, (hi << s) | (lo >> t), d, v);
+        if (qp) qp[i] = q;
+        hi = lo;
+    }
+    q = _bint_div_2by1(&r, r, hi << s, d, v);
+    if (qp) qp[0] = q;
+    return r >> s;
+}
+
+#ifndef BINT_BLK_64
+/// The reciprocal of the normalized two-block d1:d0 for _bint_div_3by2,
+/// floor((B^3 - 1) / (d1:d0)) - B.
+static bint_blk_type _bint_invert_pi1(bint_blk_type d1, bint_blk_type d0) {
+    bint_blk_type v = _bint_invert_limb(d1), p = d1 * v + d0, t1, t0;
+    if (p < d0) {
+        v--;
+        if (p >= d1) {
+            v--;
+            p -= d1;
+        }
+        p -= d1;
+    }
+    bint_dblk_type t = (bint_dblk_type)d0 * v;
+    t1 = (bint_blk_type)(t >> BINT_BLK_BIT_SZ);
+    t0 = (bint_blk_type)t;
+    p += t1;
+    if (p < t1) {
+        v--;
+        if (p >= d1 && (p > d1 || t0 >= d0)) v--;
+    }
+    return v;
+}
+
+/// Divides u2:u1:u0 by the normalized two-block d, for u2:u1 < d, with v
+/// from _bint_invert_pi1. Returns the quotient and leaves the remainder in
+/// *r. The two-block values wrap around modulo B^2, like the hardware.
+static inline bint_blk_type _bint_div_3by2(bint_dblk_type* r, bint_blk_type u2,
+                                           bint_blk_type u1, bint_blk_type u0,
+                                           bint_dblk_type d,
+                                           bint_blk_type v) {
+    bint_blk_type d1 = (bint_blk_type)(d >> BINT_BLK_BIT_SZ);
+    bint_blk_type d0 = (bint_blk_type)d;
+    bint_dblk_type q = (bint_dblk_type)v * u2 +
+                       (((bint_dblk_type)u2 << BINT_BLK_BIT_SZ) | u1);
+    bint_blk_type q1 = (bint_blk_type)(q >> BINT_BLK_BIT_SZ);
+    bint_blk_type q0 = (bint_blk_type)q;
+    bint_blk_type r1 = u1 - d1 * q1;
+    bint_dblk_type rr = (((bint_dblk_type)r1 << BINT_BLK_BIT_SZ) | u0) - d -
+                        (bint_dblk_type)d0 * q1;
+    q1++;
+    if ((bint_blk_type)(rr >> BINT_BLK_BIT_SZ) >= q0) {
+        q1--;
+        rr += d;
+    }
+    if (rr >= d) {
+        q1++;
+        rr -= d;
+    }
+    *r = rr;
+    return q1;
+}
+
+/// Block i of ap << s, for 0 < s < BINT_BLK_BIT_SZ.
+static inline bint_blk_type _bint_shl_blk(const bint_blk_type* ap, size_t i,
+                                          unsigned s) {
+    return i ? (ap[i] << s) | (ap[i - 1] >> (BINT_BLK_BIT_SZ - s))
+             : ap[i] << s;
+}
+
+/// qp[0..n) = ap[0..n) / d for a two-block d (d >= B). Returns the
+/// remainder. qp may be ap, or NULL to only get the remainder.
+static bint_dblk_type _bint_divrem_2(bint_blk_type* qp,
+                                     const bint_blk_type* ap, size_t n,
+                                     bint_dblk_type d) {
+    if (n < 2) {
+        bint_blk_type r = n ? ap[0] : 0;
+        if (qp && n) qp[0] = 0;
+        return r;
+    }
+    unsigned s = BINT_CLZ((bint_blk_type)(d >> BINT_BLK_BIT_SZ));
+    d <<= s;
+    bint_blk_type v = _bint_invert_pi1((bint_blk_type)(d >> BINT_BLK_BIT_SZ),
+                                       (bint_blk_type)d);
+    // the remainder starts as the top two blocks of ap << s, which has one
+    // more block than ap. its top block is below d's.
+    bint_dblk_type r;
+    if (s) {
+        r = ((bint_dblk_type)(ap[n - 1] >> (BINT_BLK_BIT_SZ - s))
+             << BINT_BLK_BIT_SZ) |
+            _bint_shl_blk(ap, n - 1, s);
+    } else {
+        r = ap[n - 1];
+    }
+    for (size_t i = n - 2; i + 1; i--) {
+        bint_blk_type u0 = s ? _bint_shl_blk(ap, i, s) : ap[i];
+        bint_blk_type q =
+            _bint_div_3by2(&r, (bint_blk_type)(r >> BINT_BLK_BIT_SZ),
+                           (bint_blk_type)r, u0, d, v);
+        if (qp) qp[i] = q;
+    }
+    if (qp) qp[n - 1] = 0;
+    return r >> s;
+}
+#endif
+
+/// rp[0..n) = ap[0..n) * m. Returns the carry block.
+static bint_blk_type _bint_mul_1(bint_blk_type* rp, const bint_blk_type* ap,
+                                 size_t n, bint_blk_type m) {
+    bint_blk_type carry = 0;
+#ifdef BINT_USE_MULX
+    unsigned long long hi, lo;
+    unsigned char c = 0;
+    for (size_t i = 0; i < n; i++) {
+        lo = _mulx_u64(ap[i], m, &hi);
+        c = _addcarryx_u64(c, lo, carry, (unsigned long long*)(rp + i));
+        carry = hi;
+    }
+    return carry + c;
+#else
+    bint_dblk_type tmp;
+    for (size_t i = 0; i < n; i++) {
+        tmp = (bint_dblk_type)ap[i] * m + carry;
+        carry = tmp >> BINT_BLK_BIT_SZ;
+        rp[i] = (bint_blk_type)tmp;
+    }
+    return carry;
+#endif
+}
+
+/// rp[0..n) -= ap[0..n) * m. Returns the block borrowed out of rp.
+static bint_blk_type _bint_submul_1(bint_blk_type* rp, const bint_blk_type* ap,
+                                    size_t n, bint_blk_type m) {
+    bint_blk_type borrow = 0, lo, r;
+    bint_dblk_type tmp;
+    for (size_t i = 0; i < n; i++) {
+        tmp = (bint_dblk_type)ap[i] * m + borrow;
+        lo = (bint_blk_type)tmp;
+        borrow = tmp >> BINT_BLK_BIT_SZ;
+        r = rp[i];
+        rp[i] = r - lo;
+        borrow += r < lo;
+    }
+    return borrow;
+}
+
+bint_blk_type BINT_add_n(bint_blk_type* rp, const bint_blk_type* ap,
+                         const bint_blk_type* bp, size_t n) {
+    return _bint_add_n(rp, ap, bp, n);
+}
+
+bint_blk_type BINT_sub_n(bint_blk_type* rp, const bint_blk_type* ap,
+                         const bint_blk_type* bp, size_t n) {
+    return _bint_sub_n(rp, ap, bp, n);
+}
+
+bint_blk_type BINT_mul_1(bint_blk_type* rp, const bint_blk_type* ap, size_t n,
+                         bint_blk_type m) {
+    return _bint_mul_1(rp, ap, n, m);
+}
+
+bint_blk_type BINT_addmul_1(bint_blk_type* rp, const bint_blk_type* ap,
+                            size_t n, bint_blk_type m) {
+    return _bint_addmul_1(rp, ap, n, m);
+}
+
+bint_blk_type BINT_submul_1(bint_blk_type* rp, const bint_blk_type* ap,
+                            size_t n, bint_blk_type m) {
+    return _bint_submul_1(rp, ap, n, m);
+}
+
+bint_blk_type BINT_lshift(bint_blk_type* rp, const bint_blk_type* ap,
+                          size_t n, unsigned cnt) {
+    return _bint_lshift(rp, ap, n, cnt);
+}
+
+bint_blk_type BINT_rshift(bint_blk_type* rp, const bint_blk_type* ap,
+                          size_t n, unsigned cnt) {
+    return _bint_rshift(rp, ap, n, cnt);
+}
+
+int BINT_cmp_n(const bint_blk_type* ap, const bint_blk_type* bp, size_t n) {
+    return _bint_cmp_n(ap, bp, n);
+}
+
+bint_blk_type BINT_divrem_1(bint_blk_type* qp, const bint_blk_type* ap,
+                            size_t n, bint_blk_type d) {
+    return _bint_divrem_1(qp, ap, n, d);
+}
+
+static void _bint_mul(bint_blk_type* rp, const bint_blk_type* ap, size_t an,
+                      const bint_blk_type* bp, size_t bn);
+static void _bint_sqr(bint_blk_type* rp, const bint_blk_type* ap, size_t n);
+
+static inline bool _bint_is_inline(const bigint* bi) {
+    return bi->data == bi->inl;
+}
+
+/// A view has no storage of its own, and so no capacity.
+static inline bool _bint_is_view(const bigint* bi) { return bi->cap == 0; }
+
 bigint* BINT_make() {
-    bigint* bi = (bigint*)malloc(sizeof(bigint));
+    bigint* bi = (bigint*)_bint_alloc(sizeof(bigint));
     bi->n = 0;
-    bi->data = NULL;
+    bi->cap = BINT_INLINE_BLKS;
+    bi->data = bi->inl;
     bi->flags = 0;
     return bi;
 }
 
 bigint* BINT_zero() {
-    bigint* bi = (bigint*)malloc(sizeof(bigint));
+    bigint* bi = (bigint*)_bint_alloc(sizeof(bigint));
     _bint_init_with_size(bi, 1, NULL);
     bi->data[0] = 0;
     return bi;
 }
 
 bigint* BINT_makei(int32_t i) {
-    bigint* bi = (bigint*)malloc(sizeof(bigint));
+    bigint* bi = BINT_makeui((uint32_t)(i < 0 ? -(int64_t)i : i));
     if (i < 0) {
         bi->flags = BIGINT_FLAG_NEG;
-        i = -i;
     }
-    _bint_init_with_size(bi, 1, &i);
     return bi;
 }
 
 bigint* BINT_makeui(uint32_t i) {
-    bigint* bi = (bigint*)malloc(sizeof(bigint));
-    _bint_init_with_size(bi, 1, &i);
+    bigint* bi = (bigint*)_bint_alloc(sizeof(bigint));
+    _bint_init_with_size(bi, 1, NULL);
+    bi->data[0] = i;
     return bi;
 }
 
 bigint* BINT_makel(int64_t l) {
     bool neg = l < 0;
-    bigint* res = BINT_makeul((uint64_t)(neg ? -l : l));
-    res->flags |= BIGINT_FLAG_NEG;
+    bigint* res = BINT_makeul(neg ? -(uint64_t)l : (uint64_t)l);
+    if (neg) res->flags |= BIGINT_FLAG_NEG;
     return res;
 }
 
 bigint* BINT_makeul(uint64_t l) {
-    bigint* bi = (bigint*)malloc(sizeof(bigint));
-    _bint_init_with_size(bi, 2, &l);
+    bigint* bi = (bigint*)_bint_alloc(sizeof(bigint));
+    _bint_init_with_size(bi, sizeof(uint64_t) / BINT_BLK_SZ, &l);
     return bi;
 }
 
 bigint* BINT_makep(void* p, size_t size) {
-    bigint* bi = (bigint*)malloc(sizeof(bigint));
+    bigint* bi = (bigint*)_bint_alloc(sizeof(bigint));
     _bint_init_with_size(bi, size, p);
     return bi;
 }
 
+void BINT_view(bigint* bi, const bint_blk_type* p, size_t n) {
+    bi->n = n;
+    bi->cap = 0;
+    bi->data = (bint_blk_type*)p;
+    bi->flags = 0;
+}
+
 bigint* BINT_cp(const bigint* bi) {
     bigint* cp = BINT_make();
-    cp->n = bi->n;
-    cp->flags = bi->flags;
-    cp->data = (bint_blk_type*)malloc(BINT_BLK_SZ * cp->n);
-    if (!cp->data) {
-        free(cp);
+    if (BINT_reserve(cp, bi->n)) {
+        _bint_free(cp, sizeof(bigint));
         return NULL;
     }
+    cp->n = bi->n;
+    cp->flags = bi->flags;
     memcpy(cp->data, bi->data, BINT_BLK_SZ * cp->n);
     return cp;
 }
 
 void BINT_setui(bigint* bi, uint32_t i) {
-    free(bi->data);
-    bi->n = 1;
-    bi->data = (bint_blk_type*)malloc(BINT_BLK_SZ);
+    if (_bint_resize(bi, 1)) return;
     bi->data[0] = i;
     bi->flags &= ~BIGINT_FLAG_NEG;
 }
 
 int BINT_shl(bigint* bi, size_t nbit) {
-    int leading_zeroes = __builtin_clz(bi->data[bi->n - 1]);
-    size_t add_zero_blks = nbit / BINT_BLK_BIT_SZ;
-    nbit = nbit % BINT_BLK_BIT_SZ;
-    bool new_lead_blk = nbit > leading_zeroes;
-    size_t add_blk_cnt = add_zero_blks + new_lead_blk;
-    bint_blk_type* buf =
-        (bint_blk_type*)malloc((bi->n + add_blk_cnt) * BINT_BLK_SZ);
-    bint_blk_type carry = 0;
-    bint_blk_type cur;
-    int j = 0;
-    for (; j < add_zero_blks; j++) {
-        buf[j] = 0u;
-    }
-    for (int i = 0; i < bi->n; i++, j++) {
-        cur = bi->data[i] + carry;
-        carry = cur >> (BINT_BLK_BIT_SZ - nbit);
-        buf[j] = cur << nbit;
-    }
-    if (new_lead_blk) {
-        if (!carry) {
-            free(buf);
-            return 1;
-        }
-        buf[j] = carry;
+    size_t n = _bint_normlen(bi->data, bi->n);
+    if (!n || !nbit) return 0;
+    size_t w = nbit / BINT_BLK_BIT_SZ;
+    unsigned cnt = nbit % BINT_BLK_BIT_SZ;
+    BINT_REALLOC(bi, n + w + 1);
+    bint_blk_type* d = bi->data;
+    // the funnel shift runs from the top, so it can move the blocks up as
+    // it goes
+    if (cnt) {
+        d[n + w] = _bint_lshift(d + w, d, n, cnt);
+    } else {
+        memmove(d + w, d, BINT_BLK_SZ * n);
+        d[n + w] = 0;
+    }
+    memset(d, 0, BINT_BLK_SZ * w);
+    return BINT_rlz(bi);
+}
+
+int BINT_shr(bigint* bi, size_t nbit) {
+    if (_bint_is_view(bi)) return 1;
+    size_t n = _bint_normlen(bi->data, bi->n);
+    size_t w = nbit / BINT_BLK_BIT_SZ;
+    unsigned cnt = nbit % BINT_BLK_BIT_SZ;
+    if (w >= n) {
+        bi->data[0] = 0;
+        bi->n = 1;
+        bi->flags &= ~BIGINT_FLAG_NEG;
+        return 0;
+    }
+    bint_blk_type* d = bi->data;
+    // and this one from the bottom, moving them down
+    if (cnt) {
+        _bint_rshift(d, d + w, n - w, cnt);
+    } else if (w) {
+        memmove(d, d + w, BINT_BLK_SZ * (n - w));
     }
-    free(bi->data);
-    bi->data = buf;
+    bi->n = n - w;
+    BINT_rlz(bi);
+    // there is no -0
+    if (BINT_iszero(bi)) bi->flags &= ~BIGINT_FLAG_NEG;
     return 0;
 }
 
 int BINT_shl1(bigint* bi) {
-    bint_blk_type carry = 0;
-    bint_blk_type next_carry;
-    for (size_t i = 0; i < bi->n; i++) {
-        next_carry = (bi->data[i] & BINT_BLK_HIGHEST_BIT) ? 1 : 0;
-        bi->data[i] = (bi->data[i] << 1) | carry;
-        carry = next_carry;
-    }
+    if (_bint_is_view(bi)) return 1;
+    if (!bi->n) return 0;
+    bint_blk_type carry = _bint_lshift(bi->data, bi->data, bi->n, 1);
     if (carry) {
         BINT_REALLOC(bi, bi->n + 1);
-        bi->data[bi->n - 1] = 1u;
+        bi->data[bi->n - 1] = carry;
     }
     return 0;
 }
 
 int BINT_shr1(bigint* bi) {
-    bint_blk_type carry = 0;
-    bint_blk_type next_carry;
-    for (size_t i = bi->n - 1; i + 1; i--) {
-        next_carry = (bi->data[i] & 1) ? BINT_BLK_HIGHEST_BIT : 0;
-        bi->data[i] = (bi->data[i] >> 1) | carry;
-        carry = next_carry;
-    }
+    if (_bint_is_view(bi)) return 1;
+    if (bi->n) _bint_rshift(bi->data, bi->data, bi->n, 1);
     return BINT_rlz(bi);
 }
 
 inline void BINT_free(bigint* bi) {
-    free(bi->data);
-    free(bi);
+    if (!_bint_is_inline(bi) && !_bint_is_view(bi)) {
+        _bint_free(bi->data, BINT_BLK_SZ * bi->cap);
+    }
+    _bint_free(bi, sizeof(bigint));
 }
 
 inline bool BINT_isneg(const bigint* bi) { return bi->flags & BIGINT_FLAG_NEG; }
 
 bool BINT_iszero(const bigint* bi) {
-    for (size_t i = 0; i < bi->n; i++) {
-        if (bi->data[i] != 0) {
-            return false;
-        }
-    }
-    return true;
+    return _bint_normlen(bi->data, bi->n) == 0;
 }
 
 inline void BINT_neg(bigint* bi) { bi->flags ^= BIGINT_FLAG_NEG; }
 
 int BINT_cmp(const bigint* b1, const bigint* b2) {
-    size_t max_size = MAX(b1->n, b2->n);
-    for (size_t i = max_size - 1; i + 1; i--) {
-        bint_blk_type wa = i < b1->n ? b1->data[i] : 0;
-        bint_blk_type wb = i < b2->n ? b2->data[i] : 0;
-        if (wa != wb) {
-            return wa > wb ? 1 : -1;
-        }
-    }
-    return 0;
+    size_t n1 = _bint_normlen(b1->data, b1->n);
+    size_t n2 = _bint_normlen(b2->data, b2->n);
+    if (n1 != n2) return n1 > n2 ? 1 : -1;
+    return _bint_cmp_n(b1->data, b2->data, n1);
 }
 
 int BINT_rlz(bigint* b) {
@@ -192,51 +857,177 @@ int BINT_rlz(bigint* b) {
     if (size == 0 || b->data[size - 1] != 0) return 0;
     for (size_t i = size - 2; i + 1; i--) {
         if (b->data[i] != 0) {
-            BINT_REALLOC(b, i + 1);
+            b->n = i + 1;
             return 0;
         }
     }
-    bint_blk_type* tmp = (bint_blk_type*)malloc(BINT_BLK_SZ * b->n);
-    if (!tmp) return 1;
-    free(b->data);
-    b->data = tmp;
     b->n = 1;
-    b->data[0] = 0;
     return 0;
 }
 
-bigint* BINT_divmod(bigint* n, const bigint* div) {
-    if (BINT_iszero(div)) return NULL;
-    bigint* d = BINT_cp(div);
-    size_t shift = 0;
-    while (BINT_cmp(n, d) > 0) {
-        BINT_shl1(d);
-        shift++;
+/**
+ * @brief Schoolbook long division (Knuth, TAOCP 4.3.1, Algorithm D).
+ *
+ * Divides np[0..nn) by dp[0..dn), where dn >= 2 and the highest bit of dp is
+ * set. Each quotient block is estimated from the top two blocks of the
+ * divisor and is off by at most one after the correction loop.
+ *
+ * @param qp receives the low nn - dn blocks of the quotient
+ * @param np the dividend. The remainder is left in np[0..dn).
+ * @return the highest quotient block, 0 or 1.
+ */
+static bint_blk_type _bint_divrem_basecase(bint_blk_type* qp,
+                                           bint_blk_type* np, size_t nn,
+                                           const bint_blk_type* dp,
+                                           size_t dn) {
+    bint_blk_type qh = _bint_cmp_n(np + nn - dn, dp, dn) >= 0;
+    if (qh) _bint_sub_n(np + nn - dn, np + nn - dn, dp, dn);
+
+    const bint_dblk_type base = (bint_dblk_type)1 << BINT_BLK_BIT_SZ;
+    bint_blk_type d1 = dp[dn - 1], d0 = dp[dn - 2], top, borrow;
+    bint_dblk_type num, qhat, rhat;
+    for (size_t i = nn - dn - 1; i + 1; i--) {
+        num = ((bint_dblk_type)np[i + dn] << BINT_BLK_BIT_SZ) | np[i + dn - 1];
+        qhat = num / d1;
+        rhat = num % d1;
+        while (qhat >= base ||
+               qhat * d0 > ((rhat << BINT_BLK_BIT_SZ) | np[i + dn - 2])) {
+            qhat--;
+            rhat += d1;
+            if (rhat >= base) break;
+        }
+
+        borrow = _bint_submul_1(np + i, dp, dn, (bint_blk_type)qhat);
+        top = np[i + dn];
+        np[i + dn] = top - borrow;
+        if (top < borrow) {
+            // qhat was one too large. add the divisor back.
+            qhat--;
+            np[i + dn] += _bint_add_n(np + i, np + i, dp, dn);
+        }
+        qp[i] = (bint_blk_type)qhat;
+    }
+    return qh;
+}
+
+static bint_blk_type _bint_divrem_dc_n(bint_blk_type* qp, bint_blk_type* np,
+                                       const bint_blk_type* dp, size_t n);
+
+/// Divides the dn + b blocks at np by the normalized dp[0..dn), b <= dn.
+/// The b-block quotient estimate comes from the top 2b blocks of np and the
+/// top b blocks of dp, and is then corrected against the rest of the
+/// divisor. Same contract as _bint_divrem_basecase otherwise.
+static bint_blk_type _bint_divrem_dc_block(bint_blk_type* qp,
+                                           bint_blk_type* np,
+                                           const bint_blk_type* dp,
+                                           size_t dn, size_t b) {
+    if (b < BINT_DIV_DC_THRESHOLD) {
+        return _bint_divrem_basecase(qp, np, dn + b, dp, dn);
+    }
+    bint_blk_type qh = _bint_divrem_dc_n(qp, np + dn - b, dp + dn - b, b);
+    if (b == dn) return qh;
+
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    bint_blk_type* tp = (bint_blk_type*)_bint_tmp_alloc(BINT_BLK_SZ * dn);
+    _bint_mul(tp, qp, b, dp, dn - b);
+    bint_blk_type cy = _bint_sub_n(np, np, tp, dn);
+    if (qh) cy += _bint_sub_n(np + b, np + b, dp, dn - b);
+    while (cy) {
+        qh -= _bint_sub_1(qp, qp, b, 1);
+        cy -= _bint_add_n(np, np, dp, dn);
+    }
+    _bint_tmp_release(pos);
+    return qh;
+}
+
+/// Divides np[0..2n) by the normalized dp[0..n) recursively, one half of
+/// the quotient at a time (Burnikel-Ziegler). Same contract as
+/// _bint_divrem_basecase.
+static bint_blk_type _bint_divrem_dc_n(bint_blk_type* qp, bint_blk_type* np,
+                                       const bint_blk_type* dp, size_t n) {
+    size_t lo = n / 2, hi = n - lo;
+    bint_blk_type qh = _bint_divrem_dc_block(qp + lo, np + lo, dp, n, hi);
+    _bint_divrem_dc_block(qp, np, dp, n, lo);
+    return qh;
+}
+
+/// Divide-and-conquer division of np[0..nn) by the normalized dp[0..dn),
+/// dn blocks of quotient at a time. Same contract as _bint_divrem_basecase.
+static bint_blk_type _bint_divrem_dc(bint_blk_type* qp, bint_blk_type* np,
+                                     size_t nn, const bint_blk_type* dp,
+                                     size_t dn) {
+    size_t qn = nn - dn;
+    size_t b = qn % dn ? qn % dn : dn;
+    size_t i = qn - b;
+    bint_blk_type qh = _bint_divrem_dc_block(qp + i, np + i, dp, dn, b);
+    while (i > 0) {
+        i -= dn;
+        _bint_divrem_dc_block(qp + i, np + i, dp, dn, dn);
+    }
+    return qh;
+}
+
+/// qp[0..nn-dn+2) = np[0..nn) / dp[0..dn), rp[0..dn) = np % dp. The top
+/// quotient block always ends up zero. dp[dn - 1] must be non-zero, and
+/// nn >= dn. rp may be np.
+static void _bint_tdiv_qr(bint_blk_type* qp, bint_blk_type* rp,
+                          const bint_blk_type* np, size_t nn,
+                          const bint_blk_type* dp, size_t dn) {
+    if (dn == 1) {
+        rp[0] = _bint_divrem_1(qp, np, nn, dp[0]);
+        qp[nn] = 0;
+        return;
     }
+    unsigned shift = BINT_CLZ(dp[dn - 1]);
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    bint_blk_type* buf =
+        (bint_blk_type*)_bint_tmp_alloc(BINT_BLK_SZ * (nn + 1 + dn));
+    bint_blk_type* ntmp = buf;
+    bint_blk_type* dtmp = buf + nn + 1;
+    if (shift) {
+        ntmp[nn] = _bint_lshift(ntmp, np, nn, shift);
+        _bint_lshift(dtmp, dp, dn, shift);
+    } else {
+        memcpy(ntmp, np, BINT_BLK_SZ * nn);
+        ntmp[nn] = 0;
+        memcpy(dtmp, dp, BINT_BLK_SZ * dn);
+    }
+    if (dn < BINT_DIV_DC_THRESHOLD || nn + 1 - dn < BINT_DIV_DC_THRESHOLD) {
+        qp[nn - dn + 1] = _bint_divrem_basecase(qp, ntmp, nn + 1, dtmp, dn);
+    } else {
+        qp[nn - dn + 1] = _bint_divrem_dc(qp, ntmp, nn + 1, dtmp, dn);
+    }
+    if (shift) {
+        _bint_rshift(rp, ntmp, dn, shift);
+    } else {
+        memcpy(rp, ntmp, BINT_BLK_SZ * dn);
+    }
+    _bint_tmp_release(pos);
+}
+
+bigint* BINT_divmod(bigint* n, const bigint* div) {
+    if (BINT_iszero(div) || _bint_is_view(n)) return NULL;
+    size_t nn = _bint_normlen(n->data, n->n);
+    size_t dn = _bint_normlen(div->data, div->n);
     bigint* result = BINT_make();
-    while (1) {
-        if (BINT_cmp(n, d) >= 0) {
-            BINT_set_bit_at(result, shift, true);
-            BINT_sub_from(n, d);
-        }
-        BINT_shr1(d);
-        if (shift == 0) break;
-        shift--;
+    if (nn < dn) {
+        _bint_init_with_size(result, 1, NULL);
+        result->data[0] = 0;
+        BINT_rlz(n);
+        return result;
     }
+    // one spare block, since _bint_tdiv_qr writes the (zero) high block
+    _bint_init_with_size(result, nn - dn + 2, NULL);
+    _bint_tdiv_qr(result->data, n->data, n->data, nn, div->data, dn);
+    n->n = dn;
     BINT_rlz(n);
     BINT_rlz(result);
-    BINT_free(d);
     return result;
 }
 
 int BINT_multo_imm(bigint* b, uint32_t imm) {
-    bint_blk_type carry = 0;
-    uint64_t tmp;
-    for (size_t i = 0; i < b->n; i++) {
-        tmp = (uint64_t)b->data[i] * imm + carry;
-        carry = tmp >> BINT_BLK_BIT_SZ;
-        b->data[i] = (bint_blk_type)tmp;
-    }
+    if (_bint_is_view(b)) return 1;
+    bint_blk_type carry = _bint_mul_1(b->data, b->data, b->n, imm);
     if (carry) {
         BINT_REALLOC(b, b->n + 1);
         b->data[b->n - 1] = carry;
@@ -244,116 +1035,845 @@ int BINT_multo_imm(bigint* b, uint32_t imm) {
     return 0;
 }
 
-int BINT_mul(const bigint* l, const bigint* r, bigint* res) {
-    free(res->data);
-    _bint_init_with_size(res, l->n + r->n, NULL);
-    memset(res->data, 0, BINT_BLK_SZ * res->n);
-    if (BINT_isneg(l) ^ BINT_isneg(r)) {
-        BINT_neg(res);
+int BINT_divmod_imm(bigint* b, uint64_t d, uint64_t* rem) {
+    if (!d || _bint_is_view(b)) return 1;
+    uint64_t r;
+#ifndef BINT_BLK_64
+    if (d > BINT_BLK_MAX) {
+        r = _bint_divrem_2(b->data, b->data, b->n, d);
+    } else
+#endif
+    {
+        r = _bint_divrem_1(b->data, b->data, b->n, (bint_blk_type)d);
     }
+    if (rem) *rem = r;
+    BINT_rlz(b);
+    // as in BINT_shr, a zero quotient is not negative
+    if (BINT_iszero(b)) b->flags &= ~BIGINT_FLAG_NEG;
+    return 0;
+}
 
-    const bigint* big = (l->n >= r->n) ? l : r;
-    const bigint* small = (big == l) ? r : l;
-
-    bint_blk_type* buf = (bint_blk_type*)malloc(BINT_BLK_SZ * (big->n + 1));
-
-    size_t i, j, res_idx;
-    bint_blk_type carry_mult, carry_add;
-    uint64_t tmp;
-    // multiplier loop
-    for (i = 0; i < small->n; i++) {
-        carry_mult = 0;
-        for (j = 0; j < big->n; j++) {
-            tmp = (uint64_t)big->data[j] * small->data[i] + carry_mult;
-            carry_mult = tmp >> BINT_BLK_BIT_SZ;
-            // TODO: optimization here. we don't need the buffer. we can
-            // directly add to it.
-            buf[j] = (bint_blk_type)tmp;
-        }
-        buf[j] = carry_mult;
+uint64_t BINT_mod_imm(const bigint* b, uint64_t d) {
+    if (!d) return 0;
+#ifndef BINT_BLK_64
+    if (d > BINT_BLK_MAX) return _bint_divrem_2(NULL, b->data, b->n, d);
+#endif
+    return _bint_divrem_1(NULL, b->data, b->n, (bint_blk_type)d);
+}
 
-        carry_add = 0;
-        for (res_idx = i, j = 0; j < big->n + 1; res_idx++, j++) {
-            tmp = (uint64_t)res->data[res_idx] + buf[j] + carry_add;
-            carry_add = tmp >> BINT_BLK_BIT_SZ;
-            res->data[res_idx] = (bint_blk_type)tmp;
-        }
-        res->data[res_idx] = carry_add;
+/// Schoolbook multiplication. rp[0..an+bn) = ap[0..an) * bp[0..bn). Each
+/// row is accumulated straight into rp.
+static void _bint_mul_basecase_scalar(bint_blk_type* rp,
+                                      const bint_blk_type* ap, size_t an,
+                                      const bint_blk_type* bp, size_t bn) {
+    rp[an] = _bint_mul_1(rp, ap, an, bp[0]);
+    for (size_t i = 1; i < bn; i++) {
+        rp[an + i] = _bint_addmul_1(rp + i, ap, an, bp[i]);
     }
-    return BINT_rlz(res);
 }
 
-int BINT_addto_imm(bigint* b, uint32_t imm) {
-    if (!b->n) return 1;
-    uint64_t tmp = (uint64_t)b->data[0] + imm;
-    b->data[0] = (bint_blk_type)tmp;
-    bint_blk_type carry = tmp >> BINT_BLK_BIT_SZ;
-    for (size_t i = 1; i < b->n; i++) {
-        tmp = (uint64_t)b->data[i] + carry;
-        carry = tmp >> BINT_BLK_BIT_SZ;
-        b->data[i] = (bint_blk_type)tmp;
+/// Schoolbook squaring. rp[0..2n) = ap[0..n)^2. Each product ap[i] * ap[j],
+/// i < j, is computed once, the sum is doubled, and the squares ap[i]^2 are
+/// added on the diagonal.
+static void _bint_sqr_basecase_scalar(bint_blk_type* rp,
+                                      const bint_blk_type* ap, size_t n) {
+    memset(rp, 0, BINT_BLK_SZ * 2 * n);
+    for (size_t i = 0; i + 1 < n; i++) {
+        rp[i + n] = _bint_addmul_1(rp + 2 * i + 1, ap + i + 1, n - i - 1,
+                                   ap[i]);
     }
-    if (carry) {
-        BINT_REALLOC(b, b->n + 1);
-        b->data[b->n - 1] = carry;
+    _bint_lshift(rp, rp, 2 * n, 1);
+    bint_blk_type carry = 0;
+    bint_dblk_type sq, tmp;
+    for (size_t i = 0; i < n; i++) {
+        sq = (bint_dblk_type)ap[i] * ap[i];
+        tmp = (bint_dblk_type)rp[2 * i] + (bint_blk_type)sq + carry;
+        rp[2 * i] = (bint_blk_type)tmp;
+        tmp = (bint_dblk_type)rp[2 * i + 1] + (sq >> BINT_BLK_BIT_SZ) +
+              (tmp >> BINT_BLK_BIT_SZ);
+        rp[2 * i + 1] = (bint_blk_type)tmp;
+        carry = tmp >> BINT_BLK_BIT_SZ;
     }
-    return 0;
 }
 
-int BINT_add(const bigint* l, const bigint* r, bigint* res) {
-    free(res->data);
+/// A product forked onto the thread pool.
+typedef struct {
+    _bint_task task;
+    bint_blk_type* rp;
+    const bint_blk_type* ap;
+    const bint_blk_type* bp;
+    size_t an, bn;
+} _bint_mul_job;
 
-    bint_blk_type carry = 0;
-    uint64_t tmp;
-    const bigint* big = (l->n >= r->n) ? l : r;
-    const bigint* small = (big == l) ? r : l;
-    bint_blk_type* buf = (bint_blk_type*)malloc(BINT_BLK_SZ * (big->n + 1));
-    // TODO: negative
-    if (!buf) {
-        return 1;
-    }
-    size_t i = 0;
-    for (; i < small->n; i++) {
-        tmp = (uint64_t)big->data[i] + small->data[i] + carry;
-        carry = tmp >> BINT_BLK_BIT_SZ;
-        buf[i] = (bint_blk_type)tmp;
-    }
-    for (; i < big->n; i++) {
-        tmp = (uint64_t)big->data[i] + carry;
-        if (tmp > BINT_BLK_MAX) {
-            carry = tmp >> BINT_BLK_BIT_SZ;
-        }
-        buf[i] = (bint_blk_type)tmp;
-    }
-    res->n = big->n;
-    if (carry > 0) {
-        buf[i] = carry;
-        res->n++;
-    }
-    res->data = buf;
-    return 0;
+static void _bint_mul_job_run(_bint_task* t) {
+    _bint_mul_job* job = (_bint_mul_job*)t;
+    _bint_mul(job->rp, job->ap, job->an, job->bp, job->bn);
 }
 
-int BINT_sub_from(bigint* a, const bigint* b) {
-    bint_blk_type borrow = 0;
-    bint_blk_type tmp;
-    for (size_t i = 0; i < b->n; i++) {
-        if (b->data[i] || borrow) {
-            tmp = a->data[i] - b->data[i] - borrow;
-            borrow = tmp >= a->data[i];
-            a->data[i] = tmp;
-        }
+/// rp[0..an+bn) = ap[0..an) * bp[0..bn), forked onto the pool when j is
+/// parallel and computed on the spot otherwise. job must outlive the join.
+static void _bint_mul_spawn(_bint_join* j, _bint_mul_job* job,
+                            bint_blk_type* rp, const bint_blk_type* ap,
+                            size_t an, const bint_blk_type* bp, size_t bn) {
+    if (!j->par) {
+        _bint_mul(rp, ap, an, bp, bn);
+        return;
     }
-    for (size_t i = b->n; borrow != 0; i++) {
-        borrow = a->data[i] == 0;
-        a->data[i]--;
-    }
-    return 0;
+    job->task.fn = _bint_mul_job_run;
+    job->rp = rp;
+    job->ap = ap;
+    job->an = an;
+    job->bp = bp;
+    job->bn = bn;
+    _bint_par_fork(j, &job->task);
+}
+
+/// Karatsuba multiplication, for ceil(an / 2) < bn <= an.
+/// a = a1 * B^h + a0, b = b1 * B^h + b0, and the middle coefficient
+/// a0 * b1 + a1 * b0 = a0 * b0 + a1 * b1 - (a0 - a1)(b0 - b1).
+static void _bint_mul_karatsuba(bint_blk_type* rp, const bint_blk_type* ap,
+                                size_t an, const bint_blk_type* bp,
+                                size_t bn) {
+    size_t h = (an + 1) / 2;
+    size_t s = an - h, t = bn - h;
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    bint_blk_type* buf =
+        (bint_blk_type*)_bint_tmp_alloc(BINT_BLK_SZ * (6 * h + 1));
+    bint_blk_type* da = buf;
+    bint_blk_type* db = da + h;
+    bint_blk_type* zm = db + h;
+    bint_blk_type* mid = zm + 2 * h;
+
+    // the three products are independent, so with a thread pool the outer
+    // two run on other threads while this one computes the middle one
+    _bint_join jn;
+    _bint_mul_job jobs[2];
+    _bint_par_begin(&jn, bn);
+    _bint_mul_spawn(&jn, &jobs[0], rp, ap, h, bp, h);
+    _bint_mul_spawn(&jn, &jobs[1], rp + 2 * h, ap + h, s, bp + h, t);
+
+    int neg = _bint_absdiff(da, ap, h, ap + h, s);
+    neg ^= _bint_absdiff(db, bp, h, bp + h, t);
+    _bint_mul(zm, da, h, db, h);
+    _bint_par_join(&jn);
+
+    mid[2 * h] = _bint_add(mid, rp, 2 * h, rp + 2 * h, s + t);
+    if (neg) {
+        _bint_add(mid, mid, 2 * h + 1, zm, 2 * h);
+    } else {
+        _bint_sub(mid, mid, 2 * h + 1, zm, 2 * h);
+    }
+    _bint_add_at(rp + h, an + bn - h, mid, 2 * h + 1);
+    _bint_tmp_release(pos);
+}
+
+/// Toom-Cook 3-way multiplication, for 2 * ceil(an / 3) < bn <= an.
+/// Evaluates at 0, 1, -1, 2 and infinity, then interpolates with exact
+/// divisions by 2 and 3. The five products may run on the thread pool.
+static void _bint_mul_toom3(bint_blk_type* rp, const bint_blk_type* ap,
+                            size_t an, const bint_blk_type* bp, size_t bn) {
+    size_t k = (an + 2) / 3;
+    size_t s = an - 2 * k, t = bn - 2 * k;
+    size_t l = 2 * k + 2;
+    const bint_blk_type *a0 = ap, *a1 = ap + k, *a2 = ap + 2 * k;
+    const bint_blk_type *b0 = bp, *b1 = bp + k, *b2 = bp + 2 * k;
+
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    bint_blk_type* buf =
+        (bint_blk_type*)_bint_tmp_alloc(BINT_BLK_SZ * (8 * (k + 1) + 3 * l));
+    bint_blk_type* pa = buf;
+    bint_blk_type* pb = pa + (k + 1);
+    bint_blk_type* ea = pb + (k + 1);
+    bint_blk_type* eb = ea + (k + 1);
+    bint_blk_type* ema = eb + (k + 1);
+    bint_blk_type* emb = ema + (k + 1);
+    bint_blk_type* e2a = emb + (k + 1);
+    bint_blk_type* e2b = e2a + (k + 1);
+    bint_blk_type* v1 = e2b + (k + 1);
+    bint_blk_type* vm1 = v1 + l;
+    bint_blk_type* v2 = vm1 + l;
+    bint_blk_type* vinf = rp + 4 * k;
+    _bint_join jn;
+    _bint_mul_job jobs[4];
+    _bint_par_begin(&jn, bn);
+
+    // evaluate at 0 and infinity, directly into their final places
+    _bint_mul_spawn(&jn, &jobs[0], rp, a0, k, b0, k);
+    _bint_mul_spawn(&jn, &jobs[1], vinf, a2, s, b2, t);
+
+    // evaluate at 1 and -1
+    pa[k] = _bint_add(pa, a0, k, a2, s);
+    pb[k] = _bint_add(pb, b0, k, b2, t);
+    ea[k] = pa[k] + _bint_add_n(ea, pa, a1, k);
+    eb[k] = pb[k] + _bint_add_n(eb, pb, b1, k);
+    int neg = _bint_absdiff(ema, pa, k + 1, a1, k);
+    neg ^= _bint_absdiff(emb, pb, k + 1, b1, k);
+    _bint_mul_spawn(&jn, &jobs[2], v1, ea, k + 1, eb, k + 1);
+    _bint_mul_spawn(&jn, &jobs[3], vm1, ema, k + 1, emb, k + 1);
+
+    // evaluate at 2: (2 * (2 * x2 + x1)) + x0
+    memcpy(e2a, a2, BINT_BLK_SZ * s);
+    memset(e2a + s, 0, BINT_BLK_SZ * (k + 1 - s));
+    _bint_lshift(e2a, e2a, k + 1, 1);
+    _bint_add(e2a, e2a, k + 1, a1, k);
+    _bint_lshift(e2a, e2a, k + 1, 1);
+    _bint_add(e2a, e2a, k + 1, a0, k);
+    memcpy(e2b, b2, BINT_BLK_SZ * t);
+    memset(e2b + t, 0, BINT_BLK_SZ * (k + 1 - t));
+    _bint_lshift(e2b, e2b, k + 1, 1);
+    _bint_add(e2b, e2b, k + 1, b1, k);
+    _bint_lshift(e2b, e2b, k + 1, 1);
+    _bint_add(e2b, e2b, k + 1, b0, k);
+    _bint_mul(v2, e2a, k + 1, e2b, k + 1);
+    _bint_par_join(&jn);
+
+    // interpolate. every intermediate value here is non-negative.
+    if (neg) {
+        _bint_add_n(v2, v2, vm1, l);
+        _bint_add_n(vm1, v1, vm1, l);
+    } else {
+        _bint_sub_n(v2, v2, vm1, l);
+        _bint_sub_n(vm1, v1, vm1, l);
+    }
+    _bint_divrem_1(v2, v2, l, 3);    // v2 = c1 + c2 + 3c3 + 5c4
+    _bint_rshift(vm1, vm1, l, 1);    // vm1 = c1 + c3
+    _bint_sub(v1, v1, l, rp, 2 * k);  // v1 = c1 + c2 + c3 + c4
+    _bint_sub_n(v2, v2, v1, l);
+    _bint_rshift(v2, v2, l, 1);  // v2 = c3 + 2c4
+    _bint_sub_n(v1, v1, vm1, l);
+    _bint_sub(v1, v1, l, vinf, s + t);  // v1 = c2
+    _bint_sub(v2, v2, l, vinf, s + t);
+    _bint_sub(v2, v2, l, vinf, s + t);  // v2 = c3
+    _bint_sub_n(vm1, vm1, v2, l);       // vm1 = c1
+
+    memset(rp + 2 * k, 0, BINT_BLK_SZ * 2 * k);
+    _bint_add_at(rp + k, an + bn - k, vm1, l);
+    _bint_add_at(rp + 2 * k, an + bn - 2 * k, v1, l);
+    _bint_add_at(rp + 3 * k, an + bn - 3 * k, v2, l);
+    _bint_tmp_release(pos);
+}
+
+/// Karatsuba squaring: a^2 = a1^2 * B^2h + (a0^2 + a1^2 - (a0 - a1)^2) * B^h
+/// + a0^2, with three half-size squares.
+static void _bint_sqr_karatsuba(bint_blk_type* rp, const bint_blk_type* ap,
+                                size_t n) {
+    size_t h = (n + 1) / 2;
+    size_t s = n - h;
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    bint_blk_type* buf =
+        (bint_blk_type*)_bint_tmp_alloc(BINT_BLK_SZ * (5 * h + 1));
+    bint_blk_type* da = buf;
+    bint_blk_type* zm = da + h;
+    bint_blk_type* mid = zm + 2 * h;
+    _bint_join jn;
+    _bint_mul_job jobs[2];
+    _bint_par_begin(&jn, n);
+    _bint_mul_spawn(&jn, &jobs[0], rp, ap, h, ap, h);
+    _bint_mul_spawn(&jn, &jobs[1], rp + 2 * h, ap + h, s, ap + h, s);
+
+    _bint_absdiff(da, ap, h, ap + h, s);
+    _bint_sqr(zm, da, h);
+    _bint_par_join(&jn);
+
+    mid[2 * h] = _bint_add(mid, rp, 2 * h, rp + 2 * h, 2 * s);
+    _bint_sub(mid, mid, 2 * h + 1, zm, 2 * h);
+    _bint_add_at(rp + h, 2 * n - h, mid, 2 * h + 1);
+    _bint_tmp_release(pos);
+}
+
+/// Toom-3 squaring. The same evaluation and interpolation as
+/// _bint_mul_toom3, with five squares.
+static void _bint_sqr_toom3(bint_blk_type* rp, const bint_blk_type* ap,
+                            size_t n) {
+    size_t k = (n + 2) / 3;
+    size_t s = n - 2 * k;
+    size_t l = 2 * k + 2;
+    const bint_blk_type *a0 = ap, *a1 = ap + k, *a2 = ap + 2 * k;
+
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    bint_blk_type* buf =
+        (bint_blk_type*)_bint_tmp_alloc(BINT_BLK_SZ * (4 * (k + 1) + 3 * l));
+    bint_blk_type* pa = buf;
+    bint_blk_type* ea = pa + (k + 1);
+    bint_blk_type* ema = ea + (k + 1);
+    bint_blk_type* e2a = ema + (k + 1);
+    bint_blk_type* v1 = e2a + (k + 1);
+    bint_blk_type* vm1 = v1 + l;
+    bint_blk_type* v2 = vm1 + l;
+    bint_blk_type* vinf = rp + 4 * k;
+    _bint_join jn;
+    _bint_mul_job jobs[4];
+    _bint_par_begin(&jn, n);
+
+    // evaluate at 0 and infinity, directly into their final places
+    _bint_mul_spawn(&jn, &jobs[0], rp, a0, k, a0, k);
+    _bint_mul_spawn(&jn, &jobs[1], vinf, a2, s, a2, s);
+
+    // evaluate at 1 and -1. the sign at -1 is squared away.
+    pa[k] = _bint_add(pa, a0, k, a2, s);
+    ea[k] = pa[k] + _bint_add_n(ea, pa, a1, k);
+    _bint_absdiff(ema, pa, k + 1, a1, k);
+    _bint_mul_spawn(&jn, &jobs[2], v1, ea, k + 1, ea, k + 1);
+    _bint_mul_spawn(&jn, &jobs[3], vm1, ema, k + 1, ema, k + 1);
+
+    // evaluate at 2: (2 * (2 * x2 + x1)) + x0
+    memcpy(e2a, a2, BINT_BLK_SZ * s);
+    memset(e2a + s, 0, BINT_BLK_SZ * (k + 1 - s));
+    _bint_lshift(e2a, e2a, k + 1, 1);
+    _bint_add(e2a, e2a, k + 1, a1, k);
+    _bint_lshift(e2a, e2a, k + 1, 1);
+    _bint_add(e2a, e2a, k + 1, a0, k);
+    _bint_sqr(v2, e2a, k + 1);
+    _bint_par_join(&jn);
+
+    // interpolate, as in _bint_mul_toom3
+    _bint_sub_n(v2, v2, vm1, l);
+    _bint_sub_n(vm1, v1, vm1, l);
+    _bint_divrem_1(v2, v2, l, 3);
+    _bint_rshift(vm1, vm1, l, 1);
+    _bint_sub(v1, v1, l, rp, 2 * k);
+    _bint_sub_n(v2, v2, v1, l);
+    _bint_rshift(v2, v2, l, 1);
+    _bint_sub_n(v1, v1, vm1, l);
+    _bint_sub(v1, v1, l, vinf, 2 * s);
+    _bint_sub(v2, v2, l, vinf, 2 * s);
+    _bint_sub(v2, v2, l, vinf, 2 * s);
+    _bint_sub_n(vm1, vm1, v2, l);
+
+    memset(rp + 2 * k, 0, BINT_BLK_SZ * 2 * k);
+    _bint_add_at(rp + k, 2 * n - k, vm1, l);
+    _bint_add_at(rp + 2 * k, 2 * n - 2 * k, v1, l);
+    _bint_add_at(rp + 3 * k, 2 * n - 3 * k, v2, l);
+    _bint_tmp_release(pos);
+}
+
+/// Multiplies a much longer ap by bp, one bn-block slice of ap at a time.
+static void _bint_mul_unbalanced(bint_blk_type* rp, const bint_blk_type* ap,
+                                 size_t an, const bint_blk_type* bp,
+                                 size_t bn) {
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    bint_blk_type* tmp = (bint_blk_type*)_bint_tmp_alloc(BINT_BLK_SZ * 2 * bn);
+    _bint_mul(rp, ap, bn, bp, bn);
+    memset(rp + 2 * bn, 0, BINT_BLK_SZ * (an - bn));
+    for (size_t i = bn; i < an; i += bn) {
+        size_t cl = MIN(bn, an - i);
+        _bint_mul(tmp, ap + i, cl, bp, bn);
+        _bint_add(rp + i, rp + i, an + bn - i, tmp, cl + bn);
+    }
+    _bint_tmp_release(pos);
+}
+
+#ifdef __SIZEOF_INT128__
+/// A word-size NTT prime p = c * 2^40 + 1 < 2^62, with its Montgomery
+/// constants for R = 2^64.
+typedef struct {
+    uint64_t p;    /* the prime */
+    uint64_t inv;  /* p^-1 mod R */
+    uint64_t r2;   /* R^2 mod p */
+    uint64_t g;    /* primitive root */
+} _bint_ntt_prime;
+
+static const _bint_ntt_prime _bint_ntt_primes[3] = {
+    {4611615649683210241ull, 13835128424026341377ull, 4609645307666104333ull,
+     11ull},
+    {4611613450659954689ull, 13835130623049596929ull, 2414166876511509764ull,
+     3ull},
+    {4611549678985543681ull, 13835194394724007937ull, 1696907016978753560ull,
+     19ull},
+};
+// Garner constants, in Montgomery form: p0^-1 mod p1, p0^-1 mod p2 and
+// p1^-1 mod p2. And p0 * p1 as two words.
+static const uint64_t _bint_ntt_c01 = 8388608ull;
+static const uint64_t _bint_ntt_c02 = 3381803097923011653ull;
+static const uint64_t _bint_ntt_c12 = 2385284316716949787ull;
+static const uint64_t _bint_ntt_p01_lo = 9223229100343164929ull;
+static const uint64_t _bint_ntt_p01_hi = 1152885770755768320ull;
+
+/// a * b * R^-1 mod p, for a * b < p * R.
+static inline uint64_t _bint_mont_mul(uint64_t a, uint64_t b,
+                                      const _bint_ntt_prime* q) {
+    unsigned __int128 t = (unsigned __int128)a * b;
+    uint64_t m = (uint64_t)t * q->inv;
+    uint64_t hi = (uint64_t)(t >> 64);
+    uint64_t mh = (uint64_t)(((unsigned __int128)m * q->p) >> 64);
+    return hi >= mh ? hi - mh : hi - mh + q->p;
+}
+
+static inline uint64_t _bint_mod_sub(uint64_t a, uint64_t b, uint64_t p) {
+    return a >= b ? a - b : a - b + p;
+}
+
+/// Montgomery form of x^e, for x in Montgomery form.
+static uint64_t _bint_mont_pow(uint64_t x, uint64_t e,
+                               const _bint_ntt_prime* q) {
+    uint64_t r = _bint_mont_mul(1, q->r2, q);
+    for (; e; e >>= 1) {
+        if (e & 1) r = _bint_mont_mul(r, x, q);
+        x = _bint_mont_mul(x, x, q);
+    }
+    return r;
+}
+
+/// Fills w[len..2len) with the powers of a primitive 2len-th root of unity
+/// (or of its inverse), for every power of two len < L. Montgomery form.
+static void _bint_ntt_roots(uint64_t* w, size_t L, bool inverse,
+                            const _bint_ntt_prime* q) {
+    uint64_t g = _bint_mont_mul(q->g, q->r2, q);
+    if (inverse) g = _bint_mont_pow(g, q->p - 2, q);
+    for (size_t len = 1; len < L; len <<= 1) {
+        uint64_t wl = _bint_mont_pow(g, (q->p - 1) / (len << 1), q);
+        w[len] = _bint_mont_mul(1, q->r2, q);
+        for (size_t j = 1; j < len; j++) {
+            w[len + j] = _bint_mont_mul(w[len + j - 1], wl, q);
+        }
+    }
+}
+
+/// Decimation-in-frequency transform. Natural order in, bit-reversed out.
+static void _bint_ntt_fwd(uint64_t* a, size_t L, const uint64_t* w,
+                          const _bint_ntt_prime* q) {
+    uint64_t p = q->p, u, v;
+    for (size_t len = L >> 1; len; len >>= 1) {
+        const uint64_t* wl = w + len;
+        for (size_t i = 0; i < L; i += len << 1) {
+            for (size_t j = 0; j < len; j++) {
+                u = a[i + j];
+                v = a[i + j + len];
+                a[i + j] = u + v >= p ? u + v - p : u + v;
+                v = _bint_mod_sub(u, v, p);
+                a[i + j + len] = _bint_mont_mul(v, wl[j], q);
+            }
+        }
+    }
+}
+
+/// Decimation-in-time transform with inverse roots. Bit-reversed order in,
+/// natural order out. Not scaled by 1 / L.
+static void _bint_ntt_inv(uint64_t* a, size_t L, const uint64_t* w,
+                          const _bint_ntt_prime* q) {
+    uint64_t p = q->p, u, v;
+    for (size_t len = 1; len < L; len <<= 1) {
+        const uint64_t* wl = w + len;
+        for (size_t i = 0; i < L; i += len << 1) {
+            for (size_t j = 0; j < len; j++) {
+                u = a[i + j];
+                v = _bint_mont_mul(a[i + j + len], wl[j], q);
+                a[i + j] = u + v >= p ? u + v - p : u + v;
+                a[i + j + len] = _bint_mod_sub(u, v, p);
+            }
+        }
+    }
+}
+
+/// Transforms of at most this length run on one thread. Longer ones are
+/// split into at most BINT_NTT_PAR_SPLIT tasks per outer stage, and then
+/// into two independent transforms of half the length.
+#define BINT_NTT_PAR_GRAIN 8192
+#define BINT_NTT_PAR_SPLIT 16
+
+/// A piece of a transform forked onto the thread pool: the butterflies
+/// [lo, hi) of the outer stage of a[0..L), or all of a[0..L).
+typedef struct {
+    _bint_task task;
+    uint64_t* a;
+    size_t L, lo, hi;
+    const uint64_t* w;
+    const _bint_ntt_prime* q;
+} _bint_ntt_job;
+
+static void _bint_ntt_fwd_par(uint64_t* a, size_t L, const uint64_t* w,
+                              const _bint_ntt_prime* q);
+static void _bint_ntt_inv_par(uint64_t* a, size_t L, const uint64_t* w,
+                              const _bint_ntt_prime* q);
+
+/// The outer stage of _bint_ntt_fwd, for the butterflies [lo, hi).
+static void _bint_ntt_fwd_outer(_bint_task* t) {
+    _bint_ntt_job* job = (_bint_ntt_job*)t;
+    uint64_t *a = job->a, p = job->q->p, u, v;
+    size_t len = job->L >> 1;
+    const uint64_t* wl = job->w + len;
+    for (size_t j = job->lo; j < job->hi; j++) {
+        u = a[j];
+        v = a[j + len];
+        a[j] = u + v >= p ? u + v - p : u + v;
+        v = _bint_mod_sub(u, v, p);
+        a[j + len] = _bint_mont_mul(v, wl[j], job->q);
+    }
+}
+
+/// The outer stage of _bint_ntt_inv, for the butterflies [lo, hi).
+static void _bint_ntt_inv_outer(_bint_task* t) {
+    _bint_ntt_job* job = (_bint_ntt_job*)t;
+    uint64_t *a = job->a, p = job->q->p, u, v;
+    size_t len = job->L >> 1;
+    const uint64_t* wl = job->w + len;
+    for (size_t j = job->lo; j < job->hi; j++) {
+        u = a[j];
+        v = _bint_mont_mul(a[j + len], wl[j], job->q);
+        a[j] = u + v >= p ? u + v - p : u + v;
+        a[j + len] = _bint_mod_sub(u, v, p);
+    }
+}
+
+static void _bint_ntt_fwd_run(_bint_task* t) {
+    _bint_ntt_job* job = (_bint_ntt_job*)t;
+    _bint_ntt_fwd_par(job->a, job->L, job->w, job->q);
+}
+
+static void _bint_ntt_inv_run(_bint_task* t) {
+    _bint_ntt_job* job = (_bint_ntt_job*)t;
+    _bint_ntt_inv_par(job->a, job->L, job->w, job->q);
+}
+
+/// Runs the outer stage of a transform with fn, split across the pool.
+static void _bint_ntt_par_outer(void (*fn)(_bint_task*), uint64_t* a,
+                                size_t L, const uint64_t* w,
+                                const _bint_ntt_prime* q) {
+    size_t len = L >> 1, c = MAX(len / BINT_NTT_PAR_SPLIT, 1);
+    _bint_ntt_job jobs[BINT_NTT_PAR_SPLIT];
+    _bint_join jn = {0, true};
+    for (size_t i = 0; i * c < len; i++) {
+        jobs[i].task.fn = fn;
+        jobs[i].a = a;
+        jobs[i].L = L;
+        jobs[i].lo = i * c;
+        jobs[i].hi = MIN((i + 1) * c, len);
+        jobs[i].w = w;
+        jobs[i].q = q;
+        if (jobs[i].hi < len) {
+            _bint_par_fork(&jn, &jobs[i].task);
+        } else {
+            fn(&jobs[i].task);
+        }
+    }
+    _bint_par_join(&jn);
+}
+
+/// Runs fn on both halves of a[0..L), the second one on the pool.
+static void _bint_ntt_par_halves(void (*fn)(_bint_task*), uint64_t* a,
+                                 size_t L, const uint64_t* w,
+                                 const _bint_ntt_prime* q) {
+    _bint_ntt_job jobs[2];
+    _bint_join jn = {0, true};
+    for (int i = 0; i < 2; i++) {
+        jobs[i].task.fn = fn;
+        jobs[i].a = a + i * (L >> 1);
+        jobs[i].L = L >> 1;
+        jobs[i].w = w;
+        jobs[i].q = q;
+    }
+    _bint_par_fork(&jn, &jobs[1].task);
+    fn(&jobs[0].task);
+    _bint_par_join(&jn);
+}
+
+/// _bint_ntt_fwd on the thread pool. After the outer stage, the two halves
+/// of a are transformed independently, with the same roots.
+static void _bint_ntt_fwd_par(uint64_t* a, size_t L, const uint64_t* w,
+                              const _bint_ntt_prime* q) {
+    if (L <= BINT_NTT_PAR_GRAIN) {
+        _bint_ntt_fwd(a, L, w, q);
+        return;
+    }
+    _bint_ntt_par_outer(_bint_ntt_fwd_outer, a, L, w, q);
+    _bint_ntt_par_halves(_bint_ntt_fwd_run, a, L, w, q);
+}
+
+/// _bint_ntt_inv on the thread pool, in the reverse order.
+static void _bint_ntt_inv_par(uint64_t* a, size_t L, const uint64_t* w,
+                              const _bint_ntt_prime* q) {
+    if (L <= BINT_NTT_PAR_GRAIN) {
+        _bint_ntt_inv(a, L, w, q);
+        return;
+    }
+    _bint_ntt_par_halves(_bint_ntt_inv_run, a, L, w, q);
+    _bint_ntt_par_outer(_bint_ntt_inv_outer, a, L, w, q);
+}
+
+/// The i-th 64-bit word of the number in p[0..n).
+static inline uint64_t _bint_word_at(const bint_blk_type* p, size_t n,
+                                     size_t i) {
+    uint64_t w = 0;
+    size_t idx = i * (64 / BINT_BLK_BIT_SZ);
+    for (size_t k = 0; k < 64 / BINT_BLK_BIT_SZ && idx + k < n; k++) {
+        w |= (uint64_t)p[idx + k] << (k * BINT_BLK_BIT_SZ);
+    }
+    return w;
+}
+
+/// Cyclic convolution of the 64-bit words of a and b modulo q, left in
+/// fa[0..L). fb is clobbered. A square (bp == ap) takes one forward
+/// transform instead of two. With par, the transforms run on the pool.
+static void _bint_ntt_conv(uint64_t* fa, uint64_t* fb, uint64_t* w, size_t L,
+                           const bint_blk_type* ap, size_t an,
+                           const bint_blk_type* bp, size_t bn,
+                           const _bint_ntt_prime* q, bool par) {
+    void (*fwd)(uint64_t*, size_t, const uint64_t*, const _bint_ntt_prime*) =
+        par ? _bint_ntt_fwd_par : _bint_ntt_fwd;
+    void (*inv)(uint64_t*, size_t, const uint64_t*, const _bint_ntt_prime*) =
+        par ? _bint_ntt_inv_par : _bint_ntt_inv;
+    bool sqr = ap == bp && an == bn;
+    for (size_t i = 0; i < L; i++) {
+        fa[i] = _bint_word_at(ap, an, i) % q->p;
+    }
+    _bint_ntt_roots(w, L, false, q);
+    fwd(fa, L, w, q);
+    if (sqr) {
+        fb = fa;
+    } else {
+        for (size_t i = 0; i < L; i++) {
+            fb[i] = _bint_word_at(bp, bn, i) % q->p;
+        }
+        fwd(fb, L, w, q);
+    }
+    // the pointwise product picks up a factor R^-1, and the inverse
+    // transform a factor L. scale by R / L to undo both.
+    uint64_t scale = _bint_mont_pow(_bint_mont_mul(L, q->r2, q), q->p - 2, q);
+    scale = _bint_mont_mul(scale, q->r2, q);
+    for (size_t i = 0; i < L; i++) {
+        fa[i] = _bint_mont_mul(fa[i], fb[i], q);
+    }
+    _bint_ntt_roots(w, L, true, q);
+    inv(fa, L, w, q);
+    for (size_t i = 0; i < L; i++) {
+        fa[i] = _bint_mont_mul(fa[i], scale, q);
+    }
+}
+
+/// A convolution modulo one prime forked onto the thread pool.
+typedef struct {
+    _bint_task task;
+    uint64_t *fa, *fb, *w;
+    size_t L, an, bn;
+    const bint_blk_type *ap, *bp;
+    const _bint_ntt_prime* q;
+} _bint_conv_job;
+
+static void _bint_conv_job_run(_bint_task* t) {
+    _bint_conv_job* job = (_bint_conv_job*)t;
+    _bint_ntt_conv(job->fa, job->fb, job->w, job->L, job->ap, job->an,
+                   job->bp, job->bn, job->q, job->task.join->par);
+}
+
+/// rp[0..rn) = the product whose first cnt words have the residues r0, r1
+/// and r2 modulo the three primes.
+static void _bint_ntt_crt(bint_blk_type* rp, size_t rn, const uint64_t* r0,
+                          const uint64_t* r1, const uint64_t* r2,
+                          size_t cnt) {
+    const size_t bpw = 64 / BINT_BLK_BIT_SZ;
+    const _bint_ntt_prime *q0 = &_bint_ntt_primes[0],
+                          *q1 = &_bint_ntt_primes[1],
+                          *q2 = &_bint_ntt_primes[2];
+    // x = r0 + p0 * y1 + p0 * p1 * y2, accumulated word by word into rp
+    uint64_t acc0 = 0, acc1 = 0, acc2 = 0, y1, y2, t;
+    unsigned __int128 s;
+    size_t idx = 0;
+    for (size_t i = 0; idx < rn; i++) {
+        if (i < cnt) {
+            uint64_t x0 = r0[i];
+            y1 = _bint_mod_sub(r1[i], x0 >= q1->p ? x0 - q1->p : x0, q1->p);
+            y1 = _bint_mont_mul(y1, _bint_ntt_c01, q1);
+            t = _bint_mod_sub(r2[i], x0 >= q2->p ? x0 - q2->p : x0, q2->p);
+            t = _bint_mont_mul(t, _bint_ntt_c02, q2);
+            t = _bint_mod_sub(t, y1 >= q2->p ? y1 - q2->p : y1, q2->p);
+            y2 = _bint_mont_mul(t, _bint_ntt_c12, q2);
+
+            s = (unsigned __int128)q0->p * y1 + x0 + acc0 +
+                (unsigned __int128)_bint_ntt_p01_lo * y2;
+            acc0 = (uint64_t)s;
+            s = (s >> 64) + acc1 + (unsigned __int128)_bint_ntt_p01_hi * y2;
+            acc1 = (uint64_t)s;
+            acc2 += (uint64_t)(s >> 64);
+        }
+        for (size_t k = 0; k < bpw && idx < rn; k++, idx++) {
+            rp[idx] = (bint_blk_type)(acc0 >> (k * BINT_BLK_BIT_SZ));
+        }
+        acc0 = acc1;
+        acc1 = acc2;
+        acc2 = 0;
+    }
+}
+
+/// NTT multiplication over 64-bit words, modulo three primes near 2^62 and
+/// recombined with CRT. Exact as long as min(an, bn) words stay below
+/// 2^57, i.e. always. With a thread pool, the three convolutions run at
+/// once, each with its own fb and roots.
+static void _bint_mul_ntt(bint_blk_type* rp, const bint_blk_type* ap,
+                          size_t an, const bint_blk_type* bp, size_t bn) {
+    const size_t bpw = 64 / BINT_BLK_BIT_SZ;
+    size_t aw = (an + bpw - 1) / bpw, bw = (bn + bpw - 1) / bpw;
+    size_t L = 2;
+    while (L < aw + bw) L <<= 1;
+
+    _bint_join jn;
+    _bint_conv_job jobs[3];
+    _bint_par_begin(&jn, bn);
+    size_t nb = jn.par ? 3 : 1;
+
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    uint64_t* buf =
+        (uint64_t*)_bint_tmp_alloc(sizeof(uint64_t) * (3 + 2 * nb) * L);
+    uint64_t* r0 = buf;
+    uint64_t* r1 = r0 + L;
+    uint64_t* r2 = r1 + L;
+    for (int i = 0; i < 3; i++) {
+        jobs[i].task.fn = _bint_conv_job_run;
+        jobs[i].task.join = &jn;
+        jobs[i].fa = buf + i * L;
+        jobs[i].fb = buf + (3 + 2 * (i % nb)) * L;
+        jobs[i].w = jobs[i].fb + L;
+        jobs[i].L = L;
+        jobs[i].ap = ap;
+        jobs[i].an = an;
+        jobs[i].bp = bp;
+        jobs[i].bn = bn;
+        jobs[i].q = &_bint_ntt_primes[i];
+        if (jn.par && i < 2) {
+            _bint_par_fork(&jn, &jobs[i].task);
+        } else {
+            _bint_conv_job_run(&jobs[i].task);
+        }
+    }
+    _bint_par_join(&jn);
+    _bint_ntt_crt(rp, an + bn, r0, r1, r2, aw + bw);
+    _bint_tmp_release(pos);
+}
+#endif
+
+/// rp[0..an+bn) = ap[0..an) * bp[0..bn), picking the algorithm by size.
+/// rp must not overlap either operand.
+static void _bint_mul(bint_blk_type* rp, const bint_blk_type* ap, size_t an,
+                      const bint_blk_type* bp, size_t bn) {
+    if (ap == bp && an == bn) {
+        _bint_sqr(rp, ap, an);
+        return;
+    }
+    if (an < bn) {
+        const bint_blk_type* tp = ap;
+        ap = bp;
+        bp = tp;
+        size_t tn = an;
+        an = bn;
+        bn = tn;
+    }
+    if (bn < _bint_kern.karatsuba_threshold) {
+        _bint_mul_basecase(rp, ap, an, bp, bn);
+#ifdef __SIZEOF_INT128__
+    } else if (bn >= BINT_MUL_NTT_THRESHOLD) {
+        _bint_mul_ntt(rp, ap, an, bp, bn);
+#endif
+    } else if (bn <= (an + 1) / 2) {
+        _bint_mul_unbalanced(rp, ap, an, bp, bn);
+    } else if (bn < BINT_MUL_TOOM3_THRESHOLD || bn <= 2 * ((an + 2) / 3)) {
+        _bint_mul_karatsuba(rp, ap, an, bp, bn);
+    } else {
+        _bint_mul_toom3(rp, ap, an, bp, bn);
+    }
+}
+
+/// rp[0..2n) = ap[0..n)^2, picking the algorithm by size. rp must not
+/// overlap ap.
+static void _bint_sqr(bint_blk_type* rp, const bint_blk_type* ap, size_t n) {
+    if (n < _bint_kern.sqr_karatsuba_threshold) {
+        if (n < _bint_kern.sqr_basecase_threshold) {
+            _bint_sqr_basecase_scalar(rp, ap, n);
+        } else {
+            _bint_mul_basecase(rp, ap, n, ap, n);
+        }
+#ifdef __SIZEOF_INT128__
+    } else if (n >= BINT_SQR_NTT_THRESHOLD) {
+        _bint_mul_ntt(rp, ap, n, ap, n);
+#endif
+    } else if (n < BINT_SQR_TOOM3_THRESHOLD) {
+        _bint_sqr_karatsuba(rp, ap, n);
+    } else {
+        _bint_sqr_toom3(rp, ap, n);
+    }
+}
+
+int BINT_sqr(const bigint* a, bigint* res) { return BINT_mul(a, a, res); }
+
+int BINT_mul(const bigint* l, const bigint* r, bigint* res) {
+    if (_bint_is_view(res)) return 1;
+    size_t ln = l->n, rn = r->n;
+    uint8_t neg = (l->flags ^ r->flags) & BIGINT_FLAG_NEG;
+    if (!ln || !rn) {
+        BINT_REALLOC(res, ln + rn);
+        memset(res->data, 0, BINT_BLK_SZ * res->n);
+        res->flags = 0;
+        return BINT_rlz(res);
+    }
+    if (res == l || res == r) {
+        // the product cannot overlap an operand, so build it in scratch
+        // memory and copy it into res' own storage
+        _bint_tmp_pos pos = _bint_tmp_mark();
+        bint_blk_type* tp =
+            (bint_blk_type*)_bint_tmp_alloc(BINT_BLK_SZ * (ln + rn));
+        _bint_mul(tp, l->data, ln, r->data, rn);
+        if (_bint_resize(res, ln + rn)) {
+            _bint_tmp_release(pos);
+            return 1;
+        }
+        memcpy(res->data, tp, BINT_BLK_SZ * (ln + rn));
+        _bint_tmp_release(pos);
+    } else {
+        // the old value is overwritten, so do not copy it when growing, but
+        // keep it if the storage cannot grow
+        size_t old = res->n;
+        if (res->cap < ln + rn) res->n = 0;
+        if (_bint_resize(res, ln + rn)) {
+            res->n = old;
+            return 1;
+        }
+        _bint_mul(res->data, l->data, ln, r->data, rn);
+    }
+    BINT_rlz(res);
+    // a zero operand makes a zero product, which has no sign
+    res->flags = BINT_iszero(res) ? 0 : neg;
+    return 0;
+}
+
+int BINT_multo(bigint* a, const bigint* b) { return BINT_mul(a, b, a); }
+
+int BINT_addto_imm(bigint* b, uint32_t imm) {
+    if (!b->n || _bint_is_view(b)) return 1;
+    bint_blk_type carry = _bint_add_1(b->data, b->data, b->n, imm);
+    if (carry) {
+        BINT_REALLOC(b, b->n + 1);
+        b->data[b->n - 1] = carry;
+    }
+    return 0;
+}
+
+int BINT_add(const bigint* l, const bigint* r, bigint* res) {
+    if (l->n < r->n) {
+        const bigint* t = l;
+        l = r;
+        r = t;
+    }
+    // TODO: negative
+    // res may be l or r, so take the lengths before resizing it
+    size_t ln = l->n, rn = r->n;
+    BINT_REALLOC(res, ln + 1);
+    bint_blk_type carry = _bint_add(res->data, l->data, ln, r->data, rn);
+    res->data[ln] = carry;
+    res->n = ln + (carry != 0);
+    return 0;
+}
+
+int BINT_addto(bigint* a, const bigint* b) { return BINT_add(a, b, a); }
+
+int BINT_sub_from(bigint* a, const bigint* b) {
+    if (_bint_is_view(a)) return 1;
+    size_t bn = _bint_normlen(b->data, b->n);
+    _bint_sub(a->data, a->data, a->n, b->data, bn);
+    return 0;
 }
 
 int BINT_set_bit_at(bigint* bi, size_t idx, bool set) {
     size_t blk_idx = idx / BINT_BLK_BIT_SZ;
     size_t blk_off = idx % BINT_BLK_BIT_SZ;
+    if (_bint_is_view(bi)) return 1;
     if (bi->n <= blk_idx) {
         size_t orig_size = bi->n;
         BINT_REALLOC(bi, blk_idx + 1);
@@ -363,81 +1883,1298 @@ int BINT_set_bit_at(bigint* bi, size_t idx, bool set) {
         }
     }
     if (set) {
-        bi->data[blk_idx] |= 1u << blk_off;
+        bi->data[blk_idx] |= (bint_blk_type)1 << blk_off;
     } else {
-        bi->data[blk_idx] &= ~(1u << blk_off);
+        bi->data[blk_idx] &= ~((bint_blk_type)1 << blk_off);
     }
     return 0;
 }
 
+struct bint_mod_ctx {
+    size_t sz;          /* bytes allocated for the context */
+    size_t n;           /* blocks of the modulus */
+    bint_blk_type minv; /* -m^-1 mod B, 0 for an even modulus */
+    bint_blk_type* m;   /* the modulus, m[n - 1] != 0 */
+    bint_blk_type* r2;  /* R^2 mod m, R = B^n */
+    bint_blk_type* mi;  /* -m^-1 mod R, for large moduli */
+};
+
+/// rp[0..n) = -ap[0..n) mod B^n. rp may be ap.
+static void _bint_neg_n(bint_blk_type* rp, const bint_blk_type* ap,
+                        size_t n) {
+    for (size_t i = 0; i < n; i++) rp[i] = ~ap[i];
+    _bint_add_1(rp, rp, n, 1);
+}
+
+/// xp[0..n) = m^-1 mod B^n for odd m, by Newton (Hensel) iteration from
+/// x0 = m[0]^-1 mod B, doubling the number of correct blocks each step.
+static void _bint_binvert(bint_blk_type* xp, const bint_blk_type* mp,
+                          size_t n, bint_blk_type x0) {
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    bint_blk_type* tp = (bint_blk_type*)_bint_tmp_alloc(BINT_BLK_SZ * 3 * n);
+    bint_blk_type* up = tp + 2 * n;
+    xp[0] = x0;
+    for (size_t k = 1, k2; k < n; k = k2) {
+        k2 = MIN(2 * k, n);
+        // m * x = 1 + e * B^k, and x - x * e * B^k is right to 2k blocks
+        _bint_mul(tp, mp, k2, xp, k);
+        _bint_mul(up, tp + k, k2 - k, xp, k2 - k);
+        _bint_neg_n(xp + k, up, k2 - k);
+    }
+    _bint_tmp_release(pos);
+}
+
+/**
+ * @brief Fused Montgomery multiplication (CIOS). Each row adds ap * bp[i]
+ * and q * mp to the accumulator in one pass, with q picked to clear its
+ * lowest block, so the product is never formed on its own.
+ *
+ * @param tp receives ap * bp / R mod m (not fully reduced, < 2m) in
+ * tp[n..2n]. Needs 2n + 2 blocks.
+ */
+static void _bint_mont_mul_basecase(bint_blk_type* tp,
+                                    const bint_blk_type* ap,
+                                    const bint_blk_type* bp,
+                                    const bint_mod_ctx* ctx) {
+    size_t n = ctx->n;
+    const bint_blk_type* mp = ctx->m;
+    bint_blk_type b, q, c1, c2;
+    bint_dblk_type x, y;
+    memset(tp, 0, BINT_BLK_SZ * (2 * n + 2));
+    for (size_t i = 0; i < n; i++) {
+        bint_blk_type* rp = tp + i;
+        b = bp[i];
+        q = (rp[0] + ap[0] * b) * ctx->minv;
+        c1 = c2 = 0;
+        for (size_t j = 0; j < n; j++) {
+            x = (bint_dblk_type)ap[j] * b + rp[j] + c1;
+            c1 = x >> BINT_BLK_BIT_SZ;
+            y = (bint_dblk_type)mp[j] * q + (bint_blk_type)x + c2;
+            c2 = y >> BINT_BLK_BIT_SZ;
+            rp[j] = (bint_blk_type)y;
+        }
+        x = (bint_dblk_type)rp[n] + c1 + c2;
+        rp[n] = (bint_blk_type)x;
+        rp[n + 1] += x >> BINT_BLK_BIT_SZ;
+    }
+}
+
+/// Montgomery reduction of tp[0..2n) with the fast multiplication:
+/// tp + (tp * mi mod R) * m is divisible by R. The quotient (< 2m) is left
+/// in up[n..2n], up needs 4n blocks.
+static void _bint_redc(bint_blk_type* up, const bint_blk_type* tp,
+                       const bint_mod_ctx* ctx) {
+    size_t n = ctx->n;
+    bint_blk_type* qp = up + 2 * n;
+    _bint_mul(qp, tp, n, ctx->mi, n);
+    _bint_mul(up, qp, n, ctx->m, n);
+    up[2 * n] = _bint_add_n(up, up, tp, 2 * n);
+}
+
+/// rp[0..n) = ap * bp / R mod m for an odd modulus, ap * bp mod m for an
+/// even one. ap, bp < m. rp may be ap or bp. tp is scratch of
+/// _bint_mod_mul_tmp(n) blocks.
+static void _bint_mod_mul(bint_blk_type* rp, const bint_blk_type* ap,
+                          const bint_blk_type* bp, const bint_mod_ctx* ctx,
+                          bint_blk_type* tp) {
+    size_t n = ctx->n;
+    bint_blk_type* up = tp + 2 * n + 2;
+    if (!ctx->minv) {
+        _bint_mul(tp, ap, n, bp, n);
+        _bint_tdiv_qr(up, rp, tp, 2 * n, ctx->m, n);
+        return;
+    }
+    if (!ctx->mi) {
+        _bint_mont_mul_basecase(tp, ap, bp, ctx);
+        up = tp;
+    } else {
+        _bint_mul(tp, ap, n, bp, n);
+        _bint_redc(up, tp, ctx);
+    }
+    if (up[2 * n] || _bint_cmp_n(up + n, ctx->m, n) >= 0) {
+        _bint_sub_n(rp, up + n, ctx->m, n);
+    } else {
+        memcpy(rp, up + n, BINT_BLK_SZ * n);
+    }
+}
+
+static inline size_t _bint_mod_mul_tmp(size_t n) { return 6 * n + 4; }
+
+bint_mod_ctx* BINT_modctx_make(const bigint* m) {
+    size_t n = _bint_normlen(m->data, m->n);
+    if (!n) return NULL;
+    bool odd = m->data[0] & 1;
+    size_t nblk = (odd ? 2 : 1) * n;
+    if (odd && n >= _bint_kern.redc_threshold) nblk += n;
+    size_t sz = sizeof(bint_mod_ctx) + BINT_BLK_SZ * nblk;
+    bint_mod_ctx* ctx = (bint_mod_ctx*)_bint_alloc(sz);
+    if (!ctx) return NULL;
+    ctx->sz = sz;
+    ctx->n = n;
+    ctx->m = (bint_blk_type*)(ctx + 1);
+    ctx->r2 = ctx->mi = NULL;
+    ctx->minv = 0;
+    memcpy(ctx->m, m->data, BINT_BLK_SZ * n);
+    if (!odd) return ctx;
+
+    // m * x = 1 mod 2^3 for odd m, and each step doubles the bits
+    bint_blk_type x = ctx->m[0];
+    for (int i = 0; i < 5; i++) x *= 2 - ctx->m[0] * x;
+    ctx->minv = -x;
+
+    ctx->r2 = ctx->m + n;
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    bint_blk_type* tp =
+        (bint_blk_type*)_bint_tmp_alloc(BINT_BLK_SZ * (3 * n + 4));
+    memset(tp, 0, BINT_BLK_SZ * 2 * n);
+    tp[2 * n] = 1;
+    _bint_tdiv_qr(tp + 2 * n + 1, ctx->r2, tp, 2 * n + 1, ctx->m, n);
+    _bint_tmp_release(pos);
+
+    if (n >= _bint_kern.redc_threshold) {
+        ctx->mi = ctx->r2 + n;
+        _bint_binvert(ctx->mi, ctx->m, n, x);
+        _bint_neg_n(ctx->mi, ctx->mi, n);
+    }
+    return ctx;
+}
+
+void BINT_modctx_free(bint_mod_ctx* ctx) {
+    if (ctx) _bint_free(ctx, ctx->sz);
+}
+
+/// Window size for the sliding window exponentiation, by exponent bits.
+static unsigned _bint_powmod_window(size_t ebits) {
+    static const size_t limits[] = {7, 25, 81, 241, 673};
+    unsigned k = 1;
+    while (k <= 5 && ebits > limits[k - 1]) k++;
+    return k;
+}
+
+static inline unsigned _bint_bit_at(const bint_blk_type* p, size_t i) {
+    return (p[i / BINT_BLK_BIT_SZ] >> (i % BINT_BLK_BIT_SZ)) & 1;
+}
+
+/**
+ * @brief rp[0..n) = bp^e mod m, scanning e from the top with a sliding
+ * window over a table of the odd powers of bp. Works in Montgomery form for
+ * an odd modulus.
+ *
+ * @param bp the base, n blocks and < m
+ * @param ep the exponent, en blocks with ep[en - 1] != 0
+ */
+static void _bint_powmod(bint_blk_type* rp, const bint_blk_type* bp,
+                         const bint_blk_type* ep, size_t en,
+                         const bint_mod_ctx* ctx) {
+    size_t n = ctx->n;
+    size_t ebits = en * BINT_BLK_BIT_SZ - BINT_CLZ(ep[en - 1]);
+    unsigned k = _bint_powmod_window(ebits);
+    size_t tn = (size_t)1 << (k - 1);
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    bint_blk_type* tp = (bint_blk_type*)_bint_tmp_alloc(
+        BINT_BLK_SZ * (_bint_mod_mul_tmp(n) + (tn + 1) * n));
+    bint_blk_type* tbl = tp + _bint_mod_mul_tmp(n);
+    bint_blk_type* sq = tbl + tn * n;
+
+    // tbl[j] = b^(2j + 1)
+    if (ctx->minv) {
+        _bint_mod_mul(tbl, bp, ctx->r2, ctx, tp);
+    } else {
+        memcpy(tbl, bp, BINT_BLK_SZ * n);
+    }
+    if (tn > 1) _bint_mod_mul(sq, tbl, tbl, ctx, tp);
+    for (size_t j = 1; j < tn; j++) {
+        _bint_mod_mul(tbl + j * n, tbl + (j - 1) * n, sq, ctx, tp);
+    }
+
+    bool first = true;
+    size_t i = ebits;
+    while (i > 0) {
+        if (!_bint_bit_at(ep, i - 1)) {
+            _bint_mod_mul(rp, rp, rp, ctx, tp);
+            i--;
+            continue;
+        }
+        // the window is bits [l, i) of e, with bit l set
+        size_t l = i > k ? i - k : 0;
+        while (!_bint_bit_at(ep, l)) l++;
+        size_t w = 0;
+        for (size_t j = i; j > l; j--) w = (w << 1) | _bint_bit_at(ep, j - 1);
+        if (first) {
+            memcpy(rp, tbl + (w >> 1) * n, BINT_BLK_SZ * n);
+            first = false;
+        } else {
+            for (size_t j = l; j < i; j++) _bint_mod_mul(rp, rp, rp, ctx, tp);
+            _bint_mod_mul(rp, rp, tbl + (w >> 1) * n, ctx, tp);
+        }
+        i = l;
+    }
+
+    if (ctx->minv) {
+        // out of Montgomery form: multiply by 1
+        memset(sq, 0, BINT_BLK_SZ * n);
+        sq[0] = 1;
+        _bint_mod_mul(rp, rp, sq, ctx, tp);
+    }
+    _bint_tmp_release(pos);
+}
+
+int BINT_powmod_ctx(const bigint* b, const bigint* e, const bint_mod_ctx* ctx,
+                    bigint* res) {
+    if (BINT_isneg(e)) return 1;
+    size_t n = ctx->n;
+    size_t bn = _bint_normlen(b->data, b->n);
+    size_t en = _bint_normlen(e->data, e->n);
+    bool neg = BINT_isneg(b) && en && (e->data[0] & 1);
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    bint_blk_type* rp = (bint_blk_type*)_bint_tmp_alloc(
+        BINT_BLK_SZ * (2 * n + (bn >= n ? bn - n + 2 : 0)));
+    bint_blk_type* xp = rp + n;
+    // x = |b| mod m
+    if (bn >= n) {
+        _bint_tdiv_qr(xp + n, xp, b->data, bn, ctx->m, n);
+    } else {
+        memcpy(xp, b->data, BINT_BLK_SZ * bn);
+        memset(xp + bn, 0, BINT_BLK_SZ * (n - bn));
+    }
+
+    memset(rp, 0, BINT_BLK_SZ * n);
+    if (!en) {
+        rp[0] = n > 1 || ctx->m[0] != 1;
+    } else if (_bint_normlen(xp, n)) {
+        _bint_powmod(rp, xp, e->data, en, ctx);
+        if (neg && _bint_normlen(rp, n)) _bint_sub_n(rp, ctx->m, rp, n);
+    }
+    if (_bint_resize(res, n)) {
+        _bint_tmp_release(pos);
+        return 1;
+    }
+    memcpy(res->data, rp, BINT_BLK_SZ * n);
+    res->flags = 0;
+    _bint_tmp_release(pos);
+    return BINT_rlz(res);
+}
+
+int BINT_powmod(const bigint* b, const bigint* e, const bigint* m,
+                bigint* res) {
+    bint_mod_ctx* ctx = BINT_modctx_make(m);
+    if (!ctx) return 1;
+    int ret = BINT_powmod_ctx(b, e, ctx, res);
+    BINT_modctx_free(ctx);
+    return ret;
+}
+
+/// The arrays of a batch, shared by the threads working on it. err is set
+/// when any operation fails.
+typedef struct {
+    const bigint* const* a;
+    const bigint* const* b;
+    const bigint* const* m;
+    bigint* const* res;
+    bigint** q;
+    int err;
+} _bint_batch;
+
+static void _bint_add_range(void* arg, size_t lo, size_t hi) {
+    _bint_batch* bt = (_bint_batch*)arg;
+    int err = 0;
+    for (size_t i = lo; i < hi; i++) {
+        err |= BINT_add(bt->a[i], bt->b[i], bt->res[i]);
+    }
+    if (err) __atomic_store_n(&bt->err, 1, __ATOMIC_RELAXED);
+}
+
+static void _bint_mul_range(void* arg, size_t lo, size_t hi) {
+    _bint_batch* bt = (_bint_batch*)arg;
+    int err = 0;
+    for (size_t i = lo; i < hi; i++) {
+        err |= BINT_mul(bt->a[i], bt->b[i], bt->res[i]);
+    }
+    if (err) __atomic_store_n(&bt->err, 1, __ATOMIC_RELAXED);
+}
+
+static void _bint_divmod_range(void* arg, size_t lo, size_t hi) {
+    _bint_batch* bt = (_bint_batch*)arg;
+    int err = 0;
+    for (size_t i = lo; i < hi; i++) {
+        bt->q[i] = BINT_divmod(bt->res[i], bt->b[i]);
+        err |= !bt->q[i];
+    }
+    if (err) __atomic_store_n(&bt->err, 1, __ATOMIC_RELAXED);
+}
+
+/// Makes a modulus context once for each run of the same m in the chunk.
+static void _bint_powmod_range(void* arg, size_t lo, size_t hi) {
+    _bint_batch* bt = (_bint_batch*)arg;
+    int err = 0;
+    const bigint* m = NULL;
+    bint_mod_ctx* ctx = NULL;
+    for (size_t i = lo; i < hi; i++) {
+        if (bt->m[i] != m) {
+            BINT_modctx_free(ctx);
+            m = bt->m[i];
+            ctx = BINT_modctx_make(m);
+        }
+        err |= !ctx || BINT_powmod_ctx(bt->a[i], bt->b[i], ctx, bt->res[i]);
+    }
+    BINT_modctx_free(ctx);
+    if (err) __atomic_store_n(&bt->err, 1, __ATOMIC_RELAXED);
+}
+
+int BINT_add_batch(const bigint* const l[], const bigint* const r[],
+                   bigint* const res[], size_t cnt) {
+    _bint_batch bt = {l, r, NULL, res, NULL, 0};
+    _bint_par_range(cnt, BINT_BATCH_CHUNK, _bint_add_range, &bt);
+    return bt.err;
+}
+
+int BINT_mul_batch(const bigint* const l[], const bigint* const r[],
+                   bigint* const res[], size_t cnt) {
+    _bint_batch bt = {l, r, NULL, res, NULL, 0};
+    _bint_par_range(cnt, BINT_BATCH_CHUNK, _bint_mul_range, &bt);
+    return bt.err;
+}
+
+int BINT_divmod_batch(bigint* const n[], const bigint* const div[],
+                      bigint* q[], size_t cnt) {
+    _bint_batch bt = {NULL, div, NULL, n, q, 0};
+    _bint_par_range(cnt, BINT_BATCH_CHUNK, _bint_divmod_range, &bt);
+    return bt.err;
+}
+
+int BINT_powmod_batch(const bigint* const b[], const bigint* const e[],
+                      const bigint* const m[], bigint* const res[],
+                      size_t cnt) {
+    _bint_batch bt = {b, e, m, res, NULL, 0};
+    _bint_par_range(cnt, BINT_BATCH_CHUNK, _bint_powmod_range, &bt);
+    return bt.err;
+}
+
+// SoA batches. The kernels below are the scalar versions, one lane at a
+// time; bigint_vec.c has the same algorithms on whole vectors of lanes.
+
+static void _bint_soa_add_scalar(uint64_t* rp, size_t rl, const uint64_t* ap,
+                                 size_t al, const uint64_t* bp, size_t bl,
+                                 size_t stride) {
+    for (size_t g = 0; g < stride; g++) {
+        uint64_t c = 0;
+        for (size_t j = 0; j < rl; j++) {
+            if (j < al) c += ap[j * stride + g];
+            if (j < bl) c += bp[j * stride + g];
+            rp[j * stride + g] = c & UINT32_MAX;
+            c >>= 32;
+        }
+    }
+}
+
+/// Product scanning: column k sums the low halves of its products in lo
+/// and the high halves in hi, which belong to column k + 1. Neither can
+/// overflow, so there is no carry chain inside a column.
+static void _bint_soa_mul_scalar(uint64_t* rp, size_t rl, const uint64_t* ap,
+                                 size_t al, const uint64_t* bp, size_t bl,
+                                 size_t stride) {
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    uint64_t* tp = (uint64_t*)_bint_tmp_alloc(sizeof(uint64_t) * rl);
+    for (size_t g = 0; g < stride; g++) {
+        uint64_t lo = 0, hi, p;
+        for (size_t k = 0; k < rl; k++) {
+            size_t i0 = k >= bl ? k - bl + 1 : 0, i1 = MIN(k + 1, al);
+            hi = 0;
+            for (size_t i = i0; i < i1; i++) {
+                p = ap[i * stride + g] * bp[(k - i) * stride + g];
+                lo += p & UINT32_MAX;
+                hi += p >> 32;
+            }
+            tp[k] = lo & UINT32_MAX;
+            lo = (lo >> 32) + hi;
+        }
+        for (size_t k = 0; k < rl; k++) rp[k * stride + g] = tp[k];
+    }
+    _bint_tmp_release(pos);
+}
+
+/// Montgomery multiplication by product scanning: the quotient limb q[k] is
+/// picked as soon as column k is summed, so that adding q[k] * mp clears
+/// the column, and the columns from n on are the result.
+static void _bint_soa_montmul_scalar(uint64_t* rp, const uint64_t* ap,
+                                     const uint64_t* bp, const uint64_t* mp,
+                                     const uint64_t* mi, size_t n,
+                                     size_t stride) {
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    uint64_t* q = (uint64_t*)_bint_tmp_alloc(sizeof(uint64_t) * n);
+    for (size_t g = 0; g < stride; g++) {
+        const uint64_t *a = ap + g, *b = bp + g, *m = mp + g;
+        uint64_t lo = 0, hi, p;
+        for (size_t k = 0; k < 2 * n - 1; k++) {
+            size_t i0 = k >= n ? k - n + 1 : 0, i1 = MIN(k + 1, n);
+            hi = 0;
+            for (size_t i = i0; i < i1; i++) {
+                p = a[i * stride] * b[(k - i) * stride];
+                lo += p & UINT32_MAX;
+                hi += p >> 32;
+                if (i < k) {
+                    p = q[i] * m[(k - i) * stride];
+                    lo += p & UINT32_MAX;
+                    hi += p >> 32;
+                }
+            }
+            if (k < n) {
+                q[k] = (lo * mi[g]) & UINT32_MAX;
+                p = q[k] * m[0];
+                lo += p & UINT32_MAX;
+                hi += p >> 32;
+            } else {
+                rp[(k - n) * stride + g] = lo & UINT32_MAX;
+            }
+            lo = (lo >> 32) + hi;
+        }
+        rp[(n - 1) * stride + g] = lo & UINT32_MAX;
+        // the result is below 2 * mp. subtract mp unless that borrows.
+        uint64_t top = lo >> 32, d, borrow = 0;
+        for (size_t j = 0; j < n; j++) {
+            d = rp[j * stride + g] - m[j * stride] - borrow;
+            borrow = d >> 63;
+        }
+        if (top || !borrow) {
+            borrow = 0;
+            for (size_t j = 0; j < n; j++) {
+                d = rp[j * stride + g] - m[j * stride] - borrow;
+                borrow = d >> 63;
+                rp[j * stride + g] = d & UINT32_MAX;
+            }
+        }
+    }
+    _bint_tmp_release(pos);
+}
+
+/// The j-th 32-bit limb of p[0..n).
+static inline uint32_t _bint_limb32_at(const bint_blk_type* p, size_t n,
+                                       size_t j) {
+    const size_t per = BINT_BLK_SZ / 4;
+    size_t k = j / per;
+    return k < n ? (uint32_t)(p[k] >> (32 * (j % per))) : 0;
+}
+
+bint_soa* BINT_soa_make(size_t cnt, size_t bits) {
+    bint_soa* s = (bint_soa*)_bint_alloc(sizeof(bint_soa));
+    if (!s) return NULL;
+    s->cnt = cnt;
+    s->limbs = MAX((bits + 31) / 32, 1);
+    s->stride = (cnt + 7) & ~(size_t)7;
+    size_t sz = sizeof(uint64_t) * s->limbs * s->stride;
+    s->data = (uint64_t*)_bint_alloc(sz);
+    if (!s->data && sz) {
+        _bint_free(s, sizeof(bint_soa));
+        return NULL;
+    }
+    memset(s->data, 0, sz);
+    return s;
+}
+
+void BINT_soa_free(bint_soa* s) {
+    if (!s) return;
+    _bint_free(s->data, sizeof(uint64_t) * s->limbs * s->stride);
+    _bint_free(s, sizeof(bint_soa));
+}
+
+int BINT_soa_set(bint_soa* s, size_t i, const bigint* v) {
+    size_t n = _bint_normlen(v->data, v->n);
+    size_t bits = n ? n * BINT_BLK_BIT_SZ - BINT_CLZ(v->data[n - 1]) : 0;
+    if (i >= s->cnt || bits > 32 * s->limbs) return 1;
+    for (size_t j = 0; j < s->limbs; j++) {
+        s->data[j * s->stride + i] = _bint_limb32_at(v->data, n, j);
+    }
+    return 0;
+}
+
+int BINT_soa_get(const bint_soa* s, size_t i, bigint* v) {
+    const size_t per = BINT_BLK_SZ / 4;
+    if (i >= s->cnt) return 1;
+    size_t n = (s->limbs + per - 1) / per;
+    if (v->cap < n) v->n = 0;
+    BINT_REALLOC(v, n);
+    memset(v->data, 0, BINT_BLK_SZ * n);
+    for (size_t j = 0; j < s->limbs; j++) {
+        v->data[j / per] |= (bint_blk_type)s->data[j * s->stride + i]
+                            << (32 * (j % per));
+    }
+    v->flags = 0;
+    return BINT_rlz(v);
+}
+
+int BINT_soa_add(const bint_soa* l, const bint_soa* r, bint_soa* res) {
+    if (l->cnt != res->cnt || r->cnt != res->cnt) return 1;
+    _bint_kern.soa_add(res->data, res->limbs, l->data, l->limbs, r->data,
+                       r->limbs, res->stride);
+    return 0;
+}
+
+int BINT_soa_mul(const bint_soa* l, const bint_soa* r, bint_soa* res) {
+    if (l->cnt != res->cnt || r->cnt != res->cnt) return 1;
+    _bint_kern.soa_mul(res->data, res->limbs, l->data, l->limbs, r->data,
+                       r->limbs, res->stride);
+    return 0;
+}
+
+int BINT_soa_montmul(const bint_soa* l, const bint_soa* r, const bint_soa* m,
+                     bint_soa* res) {
+    size_t cnt = res->cnt, n = res->limbs;
+    if (l->cnt != cnt || r->cnt != cnt || m->cnt != cnt || l->limbs != n ||
+        r->limbs != n || m->limbs != n) {
+        return 1;
+    }
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    uint64_t* mi = (uint64_t*)_bint_tmp_alloc(sizeof(uint64_t) * res->stride);
+    for (size_t g = 0; g < res->stride; g++) {
+        // Newton's iteration doubles the correct low bits of m^-1, from 3
+        uint32_t m0 = (uint32_t)m->data[g], x = m0;
+        for (int k = 0; k < 4; k++) x *= 2 - m0 * x;
+        mi[g] = (uint32_t)-x;
+    }
+    _bint_kern.soa_montmul(res->data, l->data, r->data, m->data, mi, n,
+                           res->stride);
+    _bint_tmp_release(pos);
+    return 0;
+}
+
+/// A read-only view of a number in blocks.
+typedef struct {
+    bint_blk_type* p;
+    size_t n;
+} _bint_span;
+
+/// Fills pw[k] with 10^(9 * 2^k), squaring until the next power would have
+/// more than maxn blocks. Returns the number of powers, at least 1. The
+/// powers are scratch memory, released with the caller's.
+static size_t _bint_pow10_table(_bint_span* pw, size_t maxn) {
+    size_t k = 0;
+    pw[0].p = (bint_blk_type*)_bint_tmp_alloc(BINT_BLK_SZ);
+    pw[0].p[0] = 1000000000u;
+    pw[0].n = 1;
+    while (2 * pw[k].n <= maxn) {
+        size_t n = 2 * pw[k].n;
+        pw[k + 1].p = (bint_blk_type*)_bint_tmp_alloc(BINT_BLK_SZ * n);
+        _bint_sqr(pw[k + 1].p, pw[k].p, pw[k].n);
+        pw[k + 1].n = _bint_normlen(pw[k + 1].p, n);
+        k++;
+    }
+    return k + 1;
+}
+
+/// Writes xp[0..xn) as exactly `width` decimal digits, zero padded. The
+/// number is split by the largest cached power of 10^9 that is about its
+/// square root, and both halves are converted recursively. xp is clobbered.
+static void _bint_to_dec(char* out, size_t width, bint_blk_type* xp, size_t xn,
+                         const _bint_span* pw, size_t k) {
+    xn = _bint_normlen(xp, xn);
+    if (xn < BINT_ITOA_DC_THRESHOLD) {
+        char* end = out + width;
+        bint_blk_type chunk;
+        while (xn) {
+            chunk = _bint_divrem_1(xp, xp, xn, 1000000000u);
+            xn = _bint_normlen(xp, xn);
+            for (int i = 0; i < 9 && end > out; i++) {
+                *--end = '0' + chunk % 10;
+                chunk /= 10;
+            }
+        }
+        memset(out, '0', end - out);
+        return;
+    }
+    while (k > 0 && pw[k].n > (xn + 1) / 2) k--;
+    size_t digits = (size_t)9 << k;
+    const _bint_span* d = &pw[k];
+
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    bint_blk_type* qp =
+        (bint_blk_type*)_bint_tmp_alloc(BINT_BLK_SZ * (xn - d->n + 2 + d->n));
+    bint_blk_type* rp = qp + xn - d->n + 2;
+    _bint_tdiv_qr(qp, rp, xp, xn, d->p, d->n);
+    _bint_to_dec(out, width - digits, qp, xn - d->n + 2, pw, k);
+    _bint_to_dec(out + width - digits, digits, rp, d->n, pw, k);
+    _bint_tmp_release(pos);
+}
+
 char* BINT_itoa(const bigint* bi) {
     if (!bi || !bi->n) return NULL;
-    strbuf* sb = STRBUF_new();
-    bigint* ten = BINT_makeui(10u);
-
-    bigint* bicp = BINT_cp(bi);
-    bigint* next;
-    char digit;
-    while (1) {
-        next = BINT_divmod(bicp, ten);
-        digit = ((bicp->n > 0) ? bicp->data[0] : 0) + '0';
-        STRBUF_pushback(sb, digit);
-        BINT_free(bicp);
-        bicp = next;
-        if (BINT_iszero(bicp)) break;
-    }
-    BINT_free(bicp);
-    BINT_free(ten);
-    if (BINT_isneg(bi)) {
-        STRBUF_pushback(sb, '-');
-    }
-    STRBUF_reverse(sb);
-
-    char* res = STRBUF_tocstr(sb);
-    STRBUF_free(sb);
+    size_t n = _bint_normlen(bi->data, bi->n);
+    bool neg = BINT_isneg(bi);
+    // an upper bound of the digits: bits * log10(2) + 1
+    uint64_t bits =
+        n ? (uint64_t)n * BINT_BLK_BIT_SZ - BINT_CLZ(bi->data[n - 1]) : 0;
+    size_t width = (size_t)(bits * 1234 / 4096) + 1;
+    char* res = (char*)malloc(width + neg + 1);
+    if (!res) return NULL;
+
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    bint_blk_type* xp = (bint_blk_type*)_bint_tmp_alloc(BINT_BLK_SZ * (n + 1));
+    memcpy(xp, bi->data, BINT_BLK_SZ * n);
+    _bint_span pw[64];
+    size_t cnt = _bint_pow10_table(pw, n);
+    _bint_to_dec(res + neg, width, xp, n, pw, cnt - 1);
+    _bint_tmp_release(pos);
+
+    size_t skip = 0;
+    while (skip + 1 < width && res[neg + skip] == '0') skip++;
+    memmove(res + neg, res + neg + skip, width - skip);
+    if (neg) res[0] = '-';
+    res[neg + width - skip] = 0;
     return res;
 }
 
-bigint* BINT_atoi(const char* s) {
-    bigint* bi = BINT_zero();
-    char* str = (char*)s;
-    if (str[0] == '-') {
-        BINT_neg(bi);
-        str++;
+/// An upper bound of the blocks needed by a len-digit decimal number:
+/// len * log2(10) bits, rounded up.
+static inline size_t _bint_dec_blocks(size_t len) {
+    return (size_t)((uint64_t)len * 851 / 256) / BINT_BLK_BIT_SZ + 1;
+}
+
+/// Parses the len decimal digits at s into rp, which has room for
+/// _bint_dec_blocks(len) blocks. Long strings are split so that the low part
+/// has 9 * 2^k digits, both parts are parsed recursively and recombined with
+/// a multiplication by the cached 10^(9 * 2^k). Returns the block count.
+static size_t _bint_from_dec(bint_blk_type* rp, const char* s, size_t len,
+                             const _bint_span* pw, size_t k) {
+    if (_bint_dec_blocks(len) < BINT_ATOI_DC_THRESHOLD) {
+        size_t rn = 0, cl;
+        bint_blk_type chunk, carry;
+        for (size_t i = 0; i < len; i += cl) {
+            cl = (i == 0 && len % 9) ? len % 9 : 9;
+            chunk = 0;
+            for (size_t j = 0; j < cl; j++) {
+                chunk = chunk * 10 + (s[i + j] - '0');
+            }
+            carry = _bint_mul_1(rp, rp, rn, _bint_10_exp(cl));
+            carry += _bint_add_1(rp, rp, rn, chunk);
+            if (carry) rp[rn++] = carry;
+        }
+        return rn;
+    }
+    while (k > 0 && ((size_t)9 << k) >= len) k--;
+    size_t lowlen = (size_t)9 << k, highlen = len - lowlen;
+    const _bint_span* d = &pw[k];
+
+    size_t hcap = _bint_dec_blocks(highlen);
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    bint_blk_type* hp = (bint_blk_type*)_bint_tmp_alloc(BINT_BLK_SZ * hcap);
+    size_t hn = _bint_from_dec(hp, s, highlen, pw, k);
+    size_t ln = _bint_from_dec(rp, s + highlen, lowlen, pw, k);
+    if (!hn) {
+        _bint_tmp_release(pos);
+        return ln;
     }
+    bint_blk_type* tp =
+        (bint_blk_type*)_bint_tmp_alloc(BINT_BLK_SZ * (hn + d->n));
+    _bint_mul(tp, hp, hn, d->p, d->n);
+    size_t tn = _bint_normlen(tp, hn + d->n);
+    // the low part is below 10^(9 * 2^k), so it is never longer than tp
+    memset(rp + ln, 0, BINT_BLK_SZ * (tn - ln));
+    if (_bint_add(rp, tp, tn, rp, ln)) rp[tn++] = 1;
+    _bint_tmp_release(pos);
+    return tn;
+}
+
+bigint* BINT_atoi(const char* s) {
+    bool neg = s[0] == '-';
+    const char* str = s + neg;
     size_t len = strlen(str);
-    size_t numblk = len / 9 + 1;
-    int err;
-    char buf[10];
-    buf[9] = 0;
-    uint32_t tmp;
-    for (size_t i = 0;; i++) {
-        strncpy(buf, str + (i * 9), 9);
-        tmp = atoi(buf);
-        err = BINT_addto_imm(bi, tmp);
-
-        if (err) goto ERROR;
-        if (i + 1 >= numblk) break;
-
-        if (i + 2 >= numblk)
-            err =
-                BINT_multo_imm(bi, _bint_10_exp(len % 9 == 0 ? 9 : (len % 9)));
-        else
-            err = BINT_multo_imm(bi, 1000000000u);
-        if (err) goto ERROR;
+    size_t cap = _bint_dec_blocks(len);
+
+    bigint* bi = (bigint*)_bint_alloc(sizeof(bigint));
+    if (!bi) return NULL;
+    _bint_init_with_size(bi, cap, NULL);
+    if (!bi->data) goto ERROR;
+    if (neg) BINT_neg(bi);
+
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    _bint_span pw[64];
+    size_t cnt = _bint_pow10_table(pw, cap / 2 + 1);
+    bi->n = _bint_from_dec(bi->data, str, len, pw, cnt - 1);
+    _bint_tmp_release(pos);
+    if (!bi->n) {
+        bi->data[0] = 0;
+        bi->n = 1;
     }
     return bi;
 
 ERROR:
-    BINT_free(bi);
+    _bint_free(bi, sizeof(bigint));
     return NULL;
 }
 
+static const char _bint_digit_chars[] = "0123456789abcdefghijklmnopqrstuv";
+
+/// The value of the digit c in bases up to 32, in either case, or -1.
+static inline int _bint_digit_val(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'v') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'V') return c - 'A' + 10;
+    return -1;
+}
+
+static void _bint_to_hex_scalar(char* out, const bint_blk_type* ap,
+                                size_t n) {
+    for (size_t i = n; i-- > 0;) {
+        for (unsigned j = BINT_BLK_BIT_SZ; j > 0; j -= 4) {
+            *out++ = _bint_digit_chars[(ap[i] >> (j - 4)) & 15];
+        }
+    }
+}
+
+static int _bint_from_hex_scalar(bint_blk_type* rp, const char* s,
+                                 size_t n) {
+    for (size_t i = n; i-- > 0;) {
+        bint_blk_type b = 0;
+        for (unsigned j = 0; j < 2 * BINT_BLK_SZ; j++) {
+            int v = _bint_digit_val(*s++);
+            if (v < 0 || v > 15) return 1;
+            b = (b << 4) | (bint_blk_type)v;
+        }
+        rp[i] = b;
+    }
+    return 0;
+}
+
+/// Writes the low nd digits of ap[0..n) in base 2^k, most significant
+/// first. A digit may straddle two blocks.
+static void _bint_to_pow2(char* out, size_t nd, const bint_blk_type* ap,
+                          size_t n, unsigned k) {
+    const bint_blk_type mask = ((bint_blk_type)1 << k) - 1;
+    for (size_t i = nd; i-- > 0;) {
+        size_t pos = i * k, b = pos / BINT_BLK_BIT_SZ;
+        unsigned o = pos % BINT_BLK_BIT_SZ;
+        bint_blk_type v = ap[b] >> o;
+        if (o + k > BINT_BLK_BIT_SZ && b + 1 < n) {
+            v |= ap[b + 1] << (BINT_BLK_BIT_SZ - o);
+        }
+        *out++ = _bint_digit_chars[v & mask];
+    }
+}
+
+/// Parses the len base 2^k digits of s into the blocks rp[0..), which must
+/// have room for ceil(len * k / BINT_BLK_BIT_SZ) of them. Returns 1 on a
+/// bad digit.
+static int _bint_from_pow2(bint_blk_type* rp, const char* s, size_t len,
+                           unsigned k) {
+    bint_blk_type acc = 0;
+    unsigned bits = 0;
+    for (size_t i = len; i-- > 0;) {
+        int v = _bint_digit_val(s[i]);
+        if (v < 0 || v >> k) return 1;
+        acc |= (bint_blk_type)v << bits;
+        bits += k;
+        if (bits >= BINT_BLK_BIT_SZ) {
+            *rp++ = acc;
+            bits -= BINT_BLK_BIT_SZ;
+            // the bits of v that did not fit
+            acc = bits ? (bint_blk_type)v >> (k - bits) : 0;
+        }
+    }
+    if (bits) *rp = acc;
+    return 0;
+}
+
+size_t BINT_strlen_pow2(const bigint* bi, unsigned k) {
+    if (k < 1 || k > 5) return 0;
+    size_t n = _bint_normlen(bi->data, bi->n);
+    size_t bits = n ? n * BINT_BLK_BIT_SZ - BINT_CLZ(bi->data[n - 1]) : 0;
+    size_t nd = bits ? (bits + k - 1) / k : 1;
+    return nd + (n && BINT_isneg(bi)) + 1;
+}
+
+size_t BINT_itoa_pow2(const bigint* bi, unsigned k, char* buf,
+                      size_t size) {
+    size_t need = BINT_strlen_pow2(bi, k);
+    if (!need || need > size) return 0;
+    size_t n = _bint_normlen(bi->data, bi->n);
+    char* out = buf;
+    if (n && BINT_isneg(bi)) *out++ = '-';
+    size_t nd = need - (out - buf) - 1;
+    if (!n) {
+        *out++ = '0';
+    } else if (k == 4) {
+        // the top block's digits, then whole blocks through the kernel
+        size_t low = 2 * BINT_BLK_SZ * (n - 1);
+        _bint_to_pow2(out, nd - low, bi->data + n - 1, 1, 4);
+        _bint_kern.to_hex(out + nd - low, bi->data, n - 1);
+        out += nd;
+    } else {
+        _bint_to_pow2(out, nd, bi->data, n, k);
+        out += nd;
+    }
+    *out = '\0';
+    return out - buf;
+}
+
+int BINT_atoi_pow2(bigint* bi, const char* s, size_t len, unsigned k) {
+    bool neg = len && s[0] == '-';
+    s += neg;
+    len -= neg;
+    if (k < 1 || k > 5 || !len) goto ERROR;
+    size_t n = (len * k + BINT_BLK_BIT_SZ - 1) / BINT_BLK_BIT_SZ;
+    BINT_REALLOC(bi, n);
+    if (k == 4) {
+        // whole blocks from the end through the kernel, then the top one
+        size_t full = len / (2 * BINT_BLK_SZ);
+        size_t head = len - 2 * BINT_BLK_SZ * full;
+        if (_bint_kern.from_hex(bi->data, s + head, full) ||
+            _bint_from_pow2(bi->data + full, s, head, 4)) {
+            goto ERROR;
+        }
+    } else if (_bint_from_pow2(bi->data, s, len, k)) {
+        goto ERROR;
+    }
+    BINT_rlz(bi);
+    bi->flags &= ~BIGINT_FLAG_NEG;
+    // "-0" is a plain 0
+    if (neg && !BINT_iszero(bi)) bi->flags |= BIGINT_FLAG_NEG;
+    return 0;
+
+ERROR:
+    BINT_setui(bi, 0);
+    return 1;
+}
+
+/// Bytes of the magnitude of ap[0..n) without leading zeros.
+static size_t _bint_byte_len(const bint_blk_type* ap, size_t n) {
+    n = _bint_normlen(ap, n);
+    if (!n) return 0;
+    return BINT_BLK_SZ * n - BINT_CLZ(ap[n - 1]) / 8;
+}
+
+/// out[0..len) = the low len bytes of ap, least significant first.
+static void _bint_to_bytes(uint8_t* out, const bint_blk_type* ap,
+                           size_t len) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(out, ap, len);
+#else
+    for (size_t i = 0; i < len; i++) {
+        out[i] = (uint8_t)(ap[i / BINT_BLK_SZ] >> (8 * (i % BINT_BLK_SZ)));
+    }
+#endif
+}
+
+/// rp[0..ceil(len / BINT_BLK_SZ)) = the len bytes of in, least significant
+/// first.
+static void _bint_from_bytes(bint_blk_type* rp, const uint8_t* in,
+                             size_t len) {
+    size_t n = (len + BINT_BLK_SZ - 1) / BINT_BLK_SZ;
+    if (n) rp[n - 1] = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(rp, in, len);
+#else
+    memset(rp, 0, BINT_BLK_SZ * n);
+    for (size_t i = 0; i < len; i++) {
+        rp[i / BINT_BLK_SZ] |= (bint_blk_type)in[i] << (8 * (i % BINT_BLK_SZ));
+    }
+#endif
+}
+
+/// The header of the wire format: the byte length of the magnitude,
+/// shifted left by one, with the sign in bit 0, as a LEB128 varint.
+static uint64_t _bint_wire_head(const bigint* bi, size_t* len) {
+    *len = _bint_byte_len(bi->data, bi->n);
+    return ((uint64_t)*len << 1) | (*len && BINT_isneg(bi));
+}
+
+size_t BINT_export_size(const bigint* bi) {
+    size_t len, sz = 1;
+    for (uint64_t h = _bint_wire_head(bi, &len); h >= 0x80; h >>= 7) sz++;
+    return sz + len;
+}
+
+size_t BINT_export(const bigint* bi, void* buf, size_t size) {
+    if (BINT_export_size(bi) > size) return 0;
+    uint8_t* out = (uint8_t*)buf;
+    size_t len;
+    uint64_t h = _bint_wire_head(bi, &len);
+    for (; h >= 0x80; h >>= 7) *out++ = (uint8_t)(h | 0x80);
+    *out++ = (uint8_t)h;
+    _bint_to_bytes(out, bi->data, len);
+    return out + len - (uint8_t*)buf;
+}
+
+size_t BINT_import(bigint* bi, const void* buf, size_t size) {
+    const uint8_t* in = (const uint8_t*)buf;
+    uint64_t h = 0;
+    size_t i = 0;
+    for (unsigned sh = 0;; sh += 7) {
+        if (i == size) return 0;
+        uint8_t c = in[i++];
+        // the tenth byte holds only bit 63
+        if (sh == 63 && c > 1) return 0;
+        h |= (uint64_t)(c & 0x7f) << sh;
+        if (!(c & 0x80)) {
+            // a varint is in its shortest form, so only 0 ends in a 0 byte
+            if (!c && sh) return 0;
+            break;
+        }
+    }
+    uint64_t len = h >> 1;
+    // nor is there a -0
+    if (len > size - i || h == 1) return 0;
+    size_t n = ((size_t)len + BINT_BLK_SZ - 1) / BINT_BLK_SZ;
+    if (_bint_resize(bi, MAX(n, 1))) return 0;
+    bi->data[0] = 0;
+    _bint_from_bytes(bi->data, in + i, (size_t)len);
+    bi->flags &= ~BIGINT_FLAG_NEG;
+    if (h & 1) bi->flags |= BIGINT_FLAG_NEG;
+    BINT_rlz(bi);
+    return i + (size_t)len;
+}
+
+/// Out-of-core arithmetic on bint_file. The passes run over runs of
+/// BINT_FILE_CHUNK blocks and ask for the next run of each operand to be
+/// read ahead while they work on the current one.
+
+int BINT_file_add(bint_file* r, const bigint* a, const bigint* b) {
+    if (a->n < b->n) {
+        const bigint* t = a;
+        a = b;
+        b = t;
+    }
+    size_t an = a->n, bn = b->n;
+    // a and b may be r->v, which this moves
+    if (BINT_file_reserve(r, an + 1)) return 1;
+    bint_blk_type* rp = r->v.data;
+    const bint_blk_type *ap = a->data, *bp = b->data;
+    bint_blk_type carry = 0;
+    for (size_t i = 0; i < an; i += BINT_FILE_CHUNK) {
+        size_t cl = MIN(BINT_FILE_CHUNK, an - i);
+        size_t bl = i < bn ? MIN(cl, bn - i) : 0;
+        if (i + cl < an) {
+            _bint_file_willneed(ap + i + cl, BINT_BLK_SZ *
+                                MIN(BINT_FILE_CHUNK, an - i - cl));
+        }
+        if (i + cl < bn) {
+            _bint_file_willneed(bp + i + cl, BINT_BLK_SZ *
+                                MIN(BINT_FILE_CHUNK, bn - i - cl));
+        }
+        if (bl) {
+            bint_blk_type c = _bint_add(rp + i, ap + i, cl, bp + i, bl);
+            carry = c + _bint_add_1(rp + i, rp + i, cl, carry);
+        } else {
+            carry = _bint_add_1(rp + i, ap + i, cl, carry);
+        }
+    }
+    rp[an] = carry;
+    r->v.n = an + 1;
+    r->v.flags &= ~BIGINT_FLAG_NEG;
+    return BINT_rlz(&r->v);
+}
+
+int BINT_file_shl(bint_file* f, size_t nbit) {
+    size_t n = _bint_normlen(f->v.data, f->v.n);
+    if (!n || !nbit) return 0;
+    size_t w = nbit / BINT_BLK_BIT_SZ;
+    unsigned cnt = nbit % BINT_BLK_BIT_SZ;
+    if (BINT_file_reserve(f, n + w + 1)) return 1;
+    bint_blk_type* d = f->v.data;
+    // from the top down, like BINT_shl. each run takes the bits shifted out
+    // of the run below it.
+    d[n + w] = 0;
+    for (size_t hi = n; hi > 0;) {
+        size_t lo = hi > BINT_FILE_CHUNK ? hi - BINT_FILE_CHUNK : 0;
+        if (lo) {
+            size_t nl = MIN(lo, BINT_FILE_CHUNK);
+            _bint_file_willneed(d + lo - nl, BINT_BLK_SZ * nl);
+        }
+        if (cnt) {
+            d[w + hi] |= _bint_lshift(d + w + lo, d + lo, hi - lo, cnt);
+        } else {
+            memmove(d + w + lo, d + lo, BINT_BLK_SZ * (hi - lo));
+        }
+        hi = lo;
+    }
+    memset(d, 0, BINT_BLK_SZ * w);
+    f->v.n = n + w + 1;
+    return BINT_rlz(&f->v);
+}
+
+int BINT_file_shr(bint_file* f, size_t nbit) {
+    size_t n = _bint_normlen(f->v.data, f->v.n);
+    size_t w = nbit / BINT_BLK_BIT_SZ;
+    unsigned cnt = nbit % BINT_BLK_BIT_SZ;
+    bint_blk_type* d = f->v.data;
+    if (w >= n) {
+        d[0] = 0;
+        f->v.n = 1;
+        f->v.flags &= ~BIGINT_FLAG_NEG;
+        return 0;
+    }
+    // from the bottom up, the other way round
+    size_t m = n - w;
+    for (size_t lo = 0; lo < m; lo += BINT_FILE_CHUNK) {
+        size_t hi = MIN(lo + BINT_FILE_CHUNK, m);
+        if (hi < m) {
+            _bint_file_willneed(d + w + hi,
+                                BINT_BLK_SZ * MIN(BINT_FILE_CHUNK, m - hi));
+        }
+        if (cnt) {
+            bint_blk_type out = _bint_rshift(d + lo, d + w + lo, hi - lo, cnt);
+            if (lo) d[lo - 1] |= out;
+        } else {
+            memmove(d + lo, d + w + lo, BINT_BLK_SZ * (hi - lo));
+        }
+    }
+    f->v.n = m;
+    BINT_rlz(&f->v);
+    // as in BINT_shr, there is no -0
+    if (BINT_iszero(&f->v)) f->v.flags &= ~BIGINT_FLAG_NEG;
+    return 0;
+}
+
+#ifdef __SIZEOF_INT128__
+/// A transform of length R * C over a row-major R x C matrix (the
+/// four-step method): transforms of length R down the columns, a twiddle
+/// factor for each entry, and transforms of length C along the rows. The
+/// column transforms leave the rows in bit-reversed order, so row i holds
+/// frequency rev[i], which the twiddle factors and the inverse allow for.
+/// The rows are transformed in place in the mapping, and the columns a
+/// panel of BINT_FILE_PANEL at a time in a copy in memory.
+typedef struct {
+    uint64_t* f;
+    size_t R, C, P;
+    const uint64_t* wr; /* the roots of the transforms of length R and C */
+    const uint64_t* wc;
+    const size_t* rev;
+    uint64_t root; /* a primitive (R * C)-th root, or its inverse */
+    const _bint_ntt_prime* q;
+    bool inverse;
+} _bint_ooc_ntt;
+
+static void _bint_ooc_rows(void* arg, size_t lo, size_t hi) {
+    const _bint_ooc_ntt* t = (const _bint_ooc_ntt*)arg;
+    for (size_t i = lo; i < hi; i++) {
+        if (t->inverse) {
+            _bint_ntt_inv(t->f + i * t->C, t->C, t->wc, t->q);
+        } else {
+            _bint_ntt_fwd(t->f + i * t->C, t->C, t->wc, t->q);
+        }
+    }
+}
+
+/// The column transforms and the twiddle factors of panels [lo, hi).
+static void _bint_ooc_cols(void* arg, size_t lo, size_t hi) {
+    const _bint_ooc_ntt* t = (const _bint_ooc_ntt*)arg;
+    size_t R = t->R, C = t->C, P = t->P;
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    uint64_t* buf = (uint64_t*)_bint_tmp_alloc(sizeof(uint64_t) * (P + 1) * R);
+    uint64_t* pw = buf + P * R;
+    for (size_t k = lo; k < hi; k++) {
+        uint64_t* f = t->f + k * P;
+        // column c of the panel goes to buf[c * R..)
+        for (size_t i = 0; i < R; i++) {
+            for (size_t c = 0; c < P; c++) buf[c * R + i] = f[i * C + c];
+        }
+        for (size_t c = 0; c < P; c++) {
+            uint64_t* col = buf + c * R;
+            // the twiddle factors of column j are root^(j * i)
+            uint64_t x = _bint_mont_pow(t->root, k * P + c, t->q);
+            pw[0] = _bint_mont_mul(1, t->q->r2, t->q);
+            for (size_t i = 1; i < R; i++) {
+                pw[i] = _bint_mont_mul(pw[i - 1], x, t->q);
+            }
+            if (!t->inverse) _bint_ntt_fwd(col, R, t->wr, t->q);
+            for (size_t i = 0; i < R; i++) {
+                col[i] = _bint_mont_mul(col[i], pw[t->rev[i]], t->q);
+            }
+            if (t->inverse) _bint_ntt_inv(col, R, t->wr, t->q);
+        }
+        for (size_t i = 0; i < R; i++) {
+            for (size_t c = 0; c < P; c++) f[i * C + c] = buf[c * R + i];
+        }
+    }
+    _bint_tmp_release(pos);
+}
+
+static void _bint_ooc_transform(_bint_ooc_ntt* t, bool inverse) {
+    t->inverse = inverse;
+    if (!inverse) _bint_par_range(t->C / t->P, 1, _bint_ooc_cols, t);
+    _bint_par_range(t->R, 1, _bint_ooc_rows, t);
+    if (inverse) _bint_par_range(t->C / t->P, 1, _bint_ooc_cols, t);
+}
+
+/// The words of a number reduced modulo a prime, into f.
+typedef struct {
+    uint64_t* f;
+    const bint_blk_type* p;
+    size_t n;
+    const _bint_ntt_prime* q;
+} _bint_ooc_load;
+
+static void _bint_ooc_load_run(void* arg, size_t lo, size_t hi) {
+    const _bint_ooc_load* ld = (const _bint_ooc_load*)arg;
+    for (size_t i = lo; i < hi; i++) {
+        ld->f[i] = _bint_word_at(ld->p, ld->n, i) % ld->q->p;
+    }
+}
+
+/// fa = fa * fb * scale, pointwise.
+typedef struct {
+    uint64_t *fa, *fb;
+    uint64_t scale;
+    const _bint_ntt_prime* q;
+} _bint_ooc_pointwise;
+
+static void _bint_ooc_pointwise_run(void* arg, size_t lo, size_t hi) {
+    const _bint_ooc_pointwise* pt = (const _bint_ooc_pointwise*)arg;
+    for (size_t i = lo; i < hi; i++) {
+        uint64_t x = _bint_mont_mul(pt->fa[i], pt->fb[i], pt->q);
+        pt->fa[i] = _bint_mont_mul(x, pt->scale, pt->q);
+    }
+}
+
+/// _bint_ntt_conv on an R x C matrix in a mapped file.
+static void _bint_ooc_conv(uint64_t* fa, uint64_t* fb, size_t R, size_t C,
+                           const bint_blk_type* ap, size_t an,
+                           const bint_blk_type* bp, size_t bn,
+                           const _bint_ntt_prime* q) {
+    size_t L = R * C;
+    bool sqr = ap == bp && an == bn;
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    uint64_t* wr = (uint64_t*)_bint_tmp_alloc(sizeof(uint64_t) * (R + C));
+    uint64_t* wc = wr + R;
+    size_t* rev = (size_t*)_bint_tmp_alloc(sizeof(size_t) * R);
+    rev[0] = 0;
+    for (size_t i = 1; i < R; i++) {
+        rev[i] = (rev[i >> 1] >> 1) | ((i & 1) ? R >> 1 : 0);
+    }
+    uint64_t g = _bint_mont_mul(q->g, q->r2, q);
+    _bint_ooc_ntt t = {fa, R, C, MIN(C, BINT_FILE_PANEL), wr, wc, rev,
+                       _bint_mont_pow(g, (q->p - 1) / L, q), q, false};
+
+    _bint_ntt_roots(wr, R, false, q);
+    _bint_ntt_roots(wc, C, false, q);
+    _bint_ooc_load ld = {fa, ap, an, q};
+    _bint_par_range(L, BINT_FILE_CHUNK, _bint_ooc_load_run, &ld);
+    _bint_ooc_transform(&t, false);
+    if (sqr) {
+        fb = fa;
+    } else {
+        ld.f = t.f = fb;
+        ld.p = bp;
+        ld.n = bn;
+        _bint_par_range(L, BINT_FILE_CHUNK, _bint_ooc_load_run, &ld);
+        _bint_ooc_transform(&t, false);
+    }
+    // scale by R / L, as in _bint_ntt_conv
+    uint64_t scale = _bint_mont_pow(_bint_mont_mul(L, q->r2, q), q->p - 2, q);
+    _bint_ooc_pointwise pt = {fa, fb, _bint_mont_mul(scale, q->r2, q), q};
+    _bint_par_range(L, BINT_FILE_CHUNK, _bint_ooc_pointwise_run, &pt);
+
+    _bint_ntt_roots(wr, R, true, q);
+    _bint_ntt_roots(wc, C, true, q);
+    t.f = fa;
+    t.root = _bint_mont_pow(t.root, q->p - 2, q);
+    _bint_ooc_transform(&t, true);
+    _bint_tmp_release(pos);
+}
+
+int BINT_file_mul(bint_file* r, const bigint* a, const bigint* b) {
+    const size_t bpw = 64 / BINT_BLK_BIT_SZ;
+    size_t an = _bint_normlen(a->data, a->n);
+    size_t bn = _bint_normlen(b->data, b->n);
+    uint8_t neg = (a->flags ^ b->flags) & BIGINT_FLAG_NEG;
+    if (!an || !bn) {
+        r->v.data[0] = 0;
+        r->v.n = 1;
+        r->v.flags &= ~BIGINT_FLAG_NEG;
+        return 0;
+    }
+    size_t aw = (an + bpw - 1) / bpw, bw = (bn + bpw - 1) / bpw;
+    // rows of C words and panels of R * BINT_FILE_PANEL words, about the
+    // same size
+    unsigned lg = 1;
+    while (((size_t)1 << lg) < aw + bw) lg++;
+    if (lg > 40) return 1;
+    unsigned lc = 0;
+    size_t target = (size_t)BINT_FILE_PANEL << lg;
+    while (lc < lg && ((size_t)1 << (2 * lc)) < target) lc++;
+    size_t L = (size_t)1 << lg, C = (size_t)1 << lc, R = L / C;
+
+    bool sqr = a->data == b->data && an == bn;
+    size_t sz = sizeof(uint64_t) * L * (sqr ? 3 : 4);
+    uint64_t* buf = (uint64_t*)_bint_file_scratch(r, sz);
+    if (!buf) return 1;
+    for (int i = 0; i < 3; i++) {
+        _bint_ooc_conv(buf + i * L, buf + 3 * L, R, C, a->data, an, b->data,
+                       bn, &_bint_ntt_primes[i]);
+    }
+    // only now, as a or b may be r->v
+    if (BINT_file_reserve(r, an + bn)) {
+        _bint_file_unmap(buf, sz);
+        return 1;
+    }
+    _bint_ntt_crt(r->v.data, an + bn, buf, buf + L, buf + 2 * L, aw + bw);
+    _bint_file_unmap(buf, sz);
+    r->v.n = an + bn;
+    r->v.flags = (r->v.flags & ~BIGINT_FLAG_NEG) | neg;
+    return BINT_rlz(&r->v);
+}
+#else
+int BINT_file_mul(bint_file* r, const bigint* a, const bigint* b) {
+    (void)r;
+    (void)a;
+    (void)b;
+    return 1;
+}
+#endif
+
 inline void _bint_init_with_size(bigint* bi, size_t n, void* val) {
     bi->n = n;
     bi->flags = 0;
-    bi->data = (bint_blk_type*)malloc(n * BINT_BLK_SZ);
+    if (n <= BINT_INLINE_BLKS) {
+        bi->cap = BINT_INLINE_BLKS;
+        bi->data = bi->inl;
+    } else {
+        bi->cap = n;
+        bi->data = (bint_blk_type*)_bint_alloc(n * BINT_BLK_SZ);
+    }
     if (val != NULL) {
         memcpy(bi->data, val, n * BINT_BLK_SZ);
     }
 }
+
+int _bint_resize(bigint* bi, size_t n) {
+    if (n > bi->cap && BINT_reserve(bi, MAX(n, 2 * bi->cap))) return 1;
+    bi->n = n;
+    return 0;
+}
+
+int BINT_reserve(bigint* bi, size_t n) {
+    if (n <= bi->cap) return 0;
+    if (_bint_is_view(bi)) return 1;
+    bint_blk_type* tmp;
+    if (_bint_is_inline(bi)) {
+        // spill the inline blocks to the heap
+        tmp = (bint_blk_type*)_bint_alloc(BINT_BLK_SZ * n);
+        if (!tmp) return 1;
+        memcpy(tmp, bi->inl, BINT_BLK_SZ * bi->n);
+    } else {
+        tmp = (bint_blk_type*)_bint_realloc(bi->data, BINT_BLK_SZ * bi->cap,
+                                            BINT_BLK_SZ * n);
+        if (!tmp) return 1;
+    }
+    bi->data = tmp;
+    bi->cap = n;
+    return 0;
+}
+
+int BINT_shrink_to_fit(bigint* bi) {
+    if (bi->n == bi->cap || _bint_is_inline(bi) || _bint_is_view(bi)) {
+        return 0;
+    }
+    if (bi->n <= BINT_INLINE_BLKS) {
+        memcpy(bi->inl, bi->data, BINT_BLK_SZ * bi->n);
+        _bint_free(bi->data, BINT_BLK_SZ * bi->cap);
+        bi->data = bi->inl;
+        bi->cap = BINT_INLINE_BLKS;
+        return 0;
+    }
+    bint_blk_type* tmp = (bint_blk_type*)_bint_realloc(
+        bi->data, BINT_BLK_SZ * bi->cap, BINT_BLK_SZ * bi->n);
+    if (!tmp) return 1;
+    bi->data = tmp;
+    bi->cap = bi->n;
+    return 0;
+}
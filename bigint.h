@@ -8,32 +8,194 @@
 
 #define BIGINT_FLAG_NEG 0x01
 
+/// Define BINT_BLK_64 to build with 64-bit blocks (and 128-bit
+/// intermediates) instead of 32-bit ones. It needs unsigned __int128.
+#ifdef BINT_BLK_64
+typedef uint64_t bint_blk_type;
+typedef unsigned __int128 bint_dblk_type; /* holds a block product */
+#define BINT_BLK_MAX UINT64_MAX
+#define BINT_CLZ(x) __builtin_clzll(x)
+#else
 typedef uint32_t bint_blk_type;
+typedef uint64_t bint_dblk_type; /* holds a block product */
+#define BINT_BLK_MAX UINT32_MAX
+#define BINT_CLZ(x) __builtin_clz(x)
+#endif
 #define BINT_BLK_SZ sizeof(bint_blk_type)
 #define BINT_BLK_BIT_SZ (BINT_BLK_SZ << 3)
-#define BINT_BLK_MAX UINT32_MAX
 
 static const bint_blk_type BINT_BLK_HIGHEST_BIT =
-    1u << (sizeof(bint_blk_type) * 8 - 1);
+    (bint_blk_type)1 << (sizeof(bint_blk_type) * 8 - 1);
 
 // #define MAKE_UINT64(uHi, uLo) ((uHi) << 32 | (uLo))
 
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+
+/// Operand sizes (in blocks of the smaller operand) at which BINT_mul
+/// switches from schoolbook to Karatsuba, from Karatsuba to Toom-3, and from
+/// Toom-3 to NTT. The NTT path needs compiler support for 128-bit integers.
+#ifndef BINT_MUL_KARATSUBA_THRESHOLD
+#define BINT_MUL_KARATSUBA_THRESHOLD 32
+#endif
+/// The Karatsuba cutoff used instead when the CPU has AVX512-IFMA.
+#ifndef BINT_MUL_KARATSUBA_THRESHOLD_IFMA
+#define BINT_MUL_KARATSUBA_THRESHOLD_IFMA 64
+#endif
+#ifndef BINT_MUL_TOOM3_THRESHOLD
+#define BINT_MUL_TOOM3_THRESHOLD 128
+#endif
+#ifndef BINT_MUL_NTT_THRESHOLD
+#ifdef BINT_BLK_64
+#define BINT_MUL_NTT_THRESHOLD 512
+#else
+#define BINT_MUL_NTT_THRESHOLD 1024
+#endif
+#endif
+/// The same cutoffs for squaring (BINT_sqr, and BINT_mul of a number by
+/// itself). The last one is where squares switch from the scalar squaring
+/// kernel to the SIMD multiply kernel, when there is one.
+#ifndef BINT_SQR_KARATSUBA_THRESHOLD
+#ifdef BINT_BLK_64
+#define BINT_SQR_KARATSUBA_THRESHOLD 32
+#else
+#define BINT_SQR_KARATSUBA_THRESHOLD 48
+#endif
+#endif
+#ifndef BINT_SQR_TOOM3_THRESHOLD
+#define BINT_SQR_TOOM3_THRESHOLD 256
+#endif
+#ifndef BINT_SQR_NTT_THRESHOLD
+#define BINT_SQR_NTT_THRESHOLD 1536
+#endif
+#ifndef BINT_SQR_BASECASE_THRESHOLD_SIMD
+#ifdef BINT_BLK_64
+#define BINT_SQR_BASECASE_THRESHOLD_SIMD 32
+#else
+#define BINT_SQR_BASECASE_THRESHOLD_SIMD 16
+#endif
+#endif
+/// Divisor size (in blocks) at which BINT_divmod switches from schoolbook to
+/// recursive divide-and-conquer division.
+#ifndef BINT_DIV_DC_THRESHOLD
+#define BINT_DIV_DC_THRESHOLD 64
+#endif
+/// Size (in blocks) at which BINT_itoa stops splitting the number by powers
+/// of 10^9 and converts the remaining piece by repeated short division.
+#ifndef BINT_ITOA_DC_THRESHOLD
+#define BINT_ITOA_DC_THRESHOLD 32
+#endif
+/// Size (in blocks) below which BINT_atoi parses a piece of the string nine
+/// digits at a time instead of splitting it in halves.
+#ifndef BINT_ATOI_DC_THRESHOLD
+#define BINT_ATOI_DC_THRESHOLD 32
+#endif
+
+/// Modulus size (in blocks) from which BINT_powmod multiplies with BINT_mul's
+/// algorithms and reduces with two more multiplications, instead of the
+/// fused Montgomery kernel. The second one is used when the schoolbook
+/// multiply has a SIMD kernel.
+#ifndef BINT_POWMOD_REDC_THRESHOLD
+#ifdef BINT_BLK_64
+#define BINT_POWMOD_REDC_THRESHOLD 256
+#else
+#define BINT_POWMOD_REDC_THRESHOLD 512
+#endif
+#endif
+#ifndef BINT_POWMOD_REDC_THRESHOLD_SIMD
+#ifdef BINT_BLK_64
+#define BINT_POWMOD_REDC_THRESHOLD_SIMD 24
+#else
+#define BINT_POWMOD_REDC_THRESHOLD_SIMD 16
+#endif
+#endif
+
+/// Operand size (in blocks of the smaller operand) from which BINT_mul
+/// splits its subproducts among the threads set by BINT_set_threads.
+#ifndef BINT_MUL_PARALLEL_THRESHOLD
+#ifdef BINT_BLK_64
+#define BINT_MUL_PARALLEL_THRESHOLD 256
+#else
+#define BINT_MUL_PARALLEL_THRESHOLD 512
+#endif
+#endif
+
+/// Operations the threads take at a time from a batch (BINT_mul_batch and
+/// the like).
+#ifndef BINT_BATCH_CHUNK
+#define BINT_BATCH_CHUNK 64
+#endif
+
+/// Blocks the out-of-core functions of bint_file work through at a time.
+#ifndef BINT_FILE_CHUNK
+#define BINT_FILE_CHUNK (1 << 20)
+#endif
+/// Words of each row that BINT_file_mul's column transforms read at once.
+/// 512 words are a 4 KiB page.
+#ifndef BINT_FILE_PANEL
+#define BINT_FILE_PANEL 512
+#endif
+
+/// Size (in bytes) of the first chunk of the per-thread scratch arena that
+/// holds the temporaries of an operation. Later chunks double in size.
+#ifndef BINT_TMP_CHUNK_SZ
+#define BINT_TMP_CHUNK_SZ 65536
+#endif
 
-#define BINT_REALLOC(bi, sz)                                   \
-    bint_blk_type* tmp =                                       \
-        (bint_blk_type*)realloc(bi->data, BINT_BLK_SZ * (sz)); \
-    if (!tmp) return 1;                                        \
-    bi->data = tmp;                                            \
-    bi->n = (sz);
+/// Sets the length of bi to sz blocks, growing its storage if needed.
+/// Returns 1 from the calling function on failure.
+#define BINT_REALLOC(bi, sz) \
+    if (_bint_resize(bi, sz)) return 1;
 
+/// Number of blocks (128 bits) a bigint stores inline, without allocating.
+#define BINT_INLINE_BLKS (16 / BINT_BLK_SZ)
+
+/// data points into the struct itself for small values, so a bigint must
+/// not be copied by value. Use BINT_cp.
 typedef struct {
     size_t n;            /* number of blocks */
+    size_t cap;          /* number of allocated blocks */
     bint_blk_type* data; /* data in blocks */
     uint8_t flags;       /* flags */
+    bint_blk_type inl[BINT_INLINE_BLKS]; /* storage for small values */
 } bigint;
 
-/// Makes an empty bigint (with NULL data)
+typedef void* (*bint_alloc_fn)(size_t size);
+typedef void* (*bint_realloc_fn)(void* p, size_t old_size, size_t new_size);
+typedef void (*bint_free_fn)(void* p, size_t size);
+
+/**
+ * @brief Sets the functions used to allocate bigints, their blocks and the
+ * scratch memory for temporaries, like GMP's mp_set_memory_functions. The
+ * sizes passed to realloc and free are the ones originally requested. A NULL
+ * argument restores the C library function. Call it before any bigint is
+ * made; strings returned by BINT_itoa are still allocated with malloc.
+ */
+void BINT_set_memory_functions(bint_alloc_fn alloc, bint_realloc_fn realloc,
+                               bint_free_fn free);
+/// Gets the current memory functions. Any argument may be NULL.
+void BINT_get_memory_functions(bint_alloc_fn* alloc, bint_realloc_fn* realloc,
+                               bint_free_fn* free);
+/// Frees the scratch memory the calling thread keeps for reuse between
+/// operations, e.g. before the thread exits.
+void BINT_free_scratch(void);
+
+/**
+ * @brief Lets multiplications of large numbers use n threads, counting the
+ * calling one, and starts the n - 1 worker threads. 0 or 1 (the default)
+ * stops them and makes everything serial again. Multiplications whose
+ * smaller operand has at least BINT_MUL_PARALLEL_THRESHOLD blocks then run
+ * their Karatsuba and Toom-3 subproducts and NTT transforms on the pool.
+ * Call it while no other thread is using the library.
+ *
+ * @return the return code. 0 for success, 1 if the threads cannot be
+ * started (or the library is built with BINT_NO_THREADS).
+ */
+int BINT_set_threads(unsigned n);
+/// The number of threads set by BINT_set_threads, at least 1.
+unsigned BINT_get_threads(void);
+
+/// Makes an empty bigint (with no blocks)
 bigint* BINT_make();
 /// Makes a bigint initialized to 0.
 bigint* BINT_zero();
@@ -42,6 +204,17 @@ bigint* BINT_makeui(uint32_t i);
 bigint* BINT_makel(int64_t l);
 bigint* BINT_makeul(uint64_t l);
 bigint* BINT_makep(void* p, size_t size);
+/**
+ * @brief Makes bi a read-only view of the n blocks at p, which stay owned by
+ * the caller and must outlive it. Nothing is copied or allocated, so p can
+ * be a limb buffer in a network frame or a mapped file, as long as it is
+ * aligned for bint_blk_type. A view can be an operand of any function that
+ * takes a const bigint*. The functions that would change it in place, such
+ * as BINT_shr, BINT_sub_from and BINT_divmod_imm, fail instead (BINT_divmod
+ * returns NULL), so p is never written. BINT_free frees only the struct,
+ * and a view on the stack needs no freeing.
+ */
+void BINT_view(bigint* bi, const bint_blk_type* p, size_t n);
 
 /// Make a copy of bi.
 bigint* BINT_cp(const bigint* bi);
@@ -50,10 +223,47 @@ void BINT_setui(bigint* bi, uint32_t i);
 
 bigint* BINT_atoi(const char* s);
 char* BINT_itoa(const bigint* bi);
+/// The size of the buffer BINT_itoa_pow2 needs for bi in base 2^k,
+/// counting the sign and the terminating null, or 0 if k is not 1 to 5.
+size_t BINT_strlen_pow2(const bigint* bi, unsigned k);
+/**
+ * @brief Writes bi in base 2^k, 1 <= k <= 5 (binary, base 4, octal, hex or
+ * base 32), into buf, with lowercase digits and no prefix. Takes linear
+ * time; hex goes through SIMD kernels.
+ * @returns the length of the string, or 0 if it does not fit in size
+ * bytes.
+ */
+size_t BINT_itoa_pow2(const bigint* bi, unsigned k, char* buf, size_t size);
+/// Sets bi to the len characters of s, an optional '-' and base 2^k digits
+/// in either case. The storage of bi is reused.
+/// @returns the status. 0 for success, 1 for a bad digit or k, in which
+/// case bi is set to 0.
+int BINT_atoi_pow2(bigint* bi, const char* s, size_t len, unsigned k);
+
+/// Bytes BINT_export writes for bi.
+size_t BINT_export_size(const bigint* bi);
+/**
+ * @brief Writes bi into buf in the wire format, which is the same for
+ * either block size: a LEB128 varint holding the byte length of the
+ * magnitude shifted left by one, with the sign in bit 0, followed by that
+ * many bytes of the magnitude, least significant first. Zero is the single
+ * byte 0.
+ * @returns the bytes written, or 0 if they do not fit in size.
+ */
+size_t BINT_export(const bigint* bi, void* buf, size_t size);
+/// Sets bi from the wire format at buf. The storage of bi is reused.
+/// @returns the bytes read, or 0 if buf is truncated, malformed (a varint
+/// not in its shortest form, or a negative 0) or memory runs out.
+size_t BINT_import(bigint* bi, const void* buf, size_t size);
 
-/// Shift left n bits.
+/// Shift left nbit bits, in place. The storage only grows when the result
+/// does not fit in it.
 /// @returns the status. 0 for success, 1 for failure.
 int BINT_shl(bigint* bi, size_t nbit);
+/// Shift right nbit bits, in place. The magnitude is shifted, so negative
+/// values round toward zero.
+/// @returns the status. 0 for success, 1 for failure.
+int BINT_shr(bigint* bi, size_t nbit);
 /// Shift left 1 bit.
 int BINT_shl1(bigint* bi);
 int BINT_shr1(bigint* bi);
@@ -67,8 +277,15 @@ bool BINT_iszero(const bigint* bi);
 void BINT_neg(bigint* bi);
 
 int BINT_cmp(const bigint* b1, const bigint* b2);
-/// Removes leading zero blocks.
+/// Removes leading zero blocks. The storage is kept for later growth.
 int BINT_rlz(bigint* b);
+/// Makes room for at least n blocks, so bi can grow to n blocks without
+/// reallocating.
+/// @returns the status. 0 for success, 1 for failure.
+int BINT_reserve(bigint* bi, size_t n);
+/// Releases the storage bi has beyond its current length.
+/// @returns the status. 0 for success, 1 for failure.
+int BINT_shrink_to_fit(bigint* bi);
 
 /// d / n -> res ... n
 /// Divide n by d, return the result, and put remainder in n.
@@ -81,17 +298,211 @@ bigint* BINT_divmod(bigint* n, const bigint* div);
  * @return the return code. 0 for success, 1 for failure.
  */
 int BINT_multo_imm(bigint* b, uint32_t imm);
+/**
+ * @brief Divide b by an immediate d != 0, in place and without allocating.
+ * The quotient is truncated and keeps the sign of b. The blocks are
+ * divided by multiplying with a reciprocal of d, which takes the only
+ * hardware division.
+ *
+ * @param rem if not NULL, gets |b| mod d
+ * @return the return code. 0 for success, 1 if d is 0.
+ */
+int BINT_divmod_imm(bigint* b, uint64_t d, uint64_t* rem);
+/// |b| mod d, for d != 0 (0 if d is 0). b is not changed.
+uint64_t BINT_mod_imm(const bigint* b, uint64_t d);
+/// res = l * r. res may be l or r, and its storage is reused when it is
+/// large enough.
+/// @returns the status. 0 for success, 1 for failure.
 int BINT_mul(const bigint* l, const bigint* r, bigint* res);
+/// a *= b.
+int BINT_multo(bigint* a, const bigint* b);
+/// res = a^2. res may be a. (BINT_mul of a number by itself squares too.)
+int BINT_sqr(const bigint* a, bigint* res);
 
 /// Add an immediate value imm to a bigint b.
 int BINT_addto_imm(bigint* b, uint32_t imm);
+/// res = l + r. res may be l or r, and its storage is reused when it is
+/// large enough.
 int BINT_add(const bigint* l, const bigint* r, bigint* res);
+/// a += b.
+int BINT_addto(bigint* a, const bigint* b);
 /// Subtract b from a. Assumed a >= b.
 /// a -= b.
 int BINT_sub_from(bigint* a, const bigint* b);
 
 int BINT_set_bit_at(bigint* bi, size_t idx, bool set);
 
+/// The setup BINT_powmod needs for a modulus (Montgomery constants for an
+/// odd one), to reuse across calls with the same modulus.
+typedef struct bint_mod_ctx bint_mod_ctx;
+
+/// Makes the context for the modulus |m|. Returns NULL if m is 0 or memory
+/// runs out.
+bint_mod_ctx* BINT_modctx_make(const bigint* m);
+void BINT_modctx_free(bint_mod_ctx* ctx);
+/**
+ * @brief res = b^e mod m, in [0, m). res may be any of the arguments.
+ *
+ * @return the return code. 0 for success, 1 for failure (e < 0, m = 0 or
+ * out of memory).
+ */
+int BINT_powmod(const bigint* b, const bigint* e, const bigint* m,
+                bigint* res);
+/// BINT_powmod with the modulus of ctx.
+int BINT_powmod_ctx(const bigint* b, const bigint* e, const bint_mod_ctx* ctx,
+                    bigint* res);
+
+/// Batches of independent operations: operation i is done on element i of
+/// each array, for i < cnt, in chunks of BINT_BATCH_CHUNK spread over the
+/// threads set by BINT_set_threads. Every operation is carried out even if
+/// another one fails. A result may be an operand of its own operation, but
+/// not an argument of any other one in the batch.
+/// @returns the status. 0 for success, 1 if any operation failed.
+
+/// res[i] = l[i] + r[i].
+int BINT_add_batch(const bigint* const l[], const bigint* const r[],
+                   bigint* const res[], size_t cnt);
+/// res[i] = l[i] * r[i].
+int BINT_mul_batch(const bigint* const l[], const bigint* const r[],
+                   bigint* const res[], size_t cnt);
+/// q[i] = BINT_divmod(n[i], div[i]), which leaves the remainder in n[i].
+/// q[i] is NULL for a failed division.
+int BINT_divmod_batch(bigint* const n[], const bigint* const div[],
+                      bigint* q[], size_t cnt);
+/// res[i] = b[i]^e[i] mod m[i]. A modulus context is made once for each
+/// run of the same m[i] pointer, so a batch with one modulus can pass the
+/// same bigint everywhere.
+int BINT_powmod_batch(const bigint* const b[], const bigint* const e[],
+                      const bigint* const m[], bigint* const res[],
+                      size_t cnt);
+
+/// A batch of cnt non-negative numbers of the same width, stored for SIMD
+/// (structure of arrays): limb j (32 bits, zero-extended to 64) of number i
+/// is data[j * stride + i], so a vector load takes the same limb of several
+/// numbers and the lanes never carry into each other. stride is cnt
+/// rounded up to a multiple of 8.
+typedef struct {
+    size_t cnt;     /* numbers */
+    size_t limbs;   /* 32-bit limbs per number */
+    size_t stride;  /* slots per limb */
+    uint64_t* data; /* the limbs */
+} bint_soa;
+
+/// Makes a batch of cnt numbers of (at most) bits bits, all 0. Returns NULL
+/// if memory runs out.
+bint_soa* BINT_soa_make(size_t cnt, size_t bits);
+void BINT_soa_free(bint_soa* s);
+/// Sets number i of s to |v|. Returns 1 if i is out of range or |v| does
+/// not fit.
+int BINT_soa_set(bint_soa* s, size_t i, const bigint* v);
+/// Sets v to number i of s.
+/// @returns the status. 0 for success, 1 for failure.
+int BINT_soa_get(const bint_soa* s, size_t i, bigint* v);
+/// res = l + r and res = l * r for every number, in lockstep. The operands
+/// may have any widths, and res keeps as many low limbs of each result as
+/// it has. res may be l or r.
+/// @returns the status. 0 for success, 1 if the counts differ.
+int BINT_soa_add(const bint_soa* l, const bint_soa* r, bint_soa* res);
+int BINT_soa_mul(const bint_soa* l, const bint_soa* r, bint_soa* res);
+/**
+ * @brief Montgomery multiplication of every number, in lockstep:
+ * res = l * r / R mod m, with R = 2^(32 * limbs). Each number has its own
+ * modulus in m, which must be odd, and l and r must be below it. To work in
+ * Montgomery form, multiply by R^2 mod m to enter it and by 1 to leave.
+ * res may be l or r.
+ *
+ * @return the return code. 0 for success, 1 if the counts or widths differ.
+ */
+int BINT_soa_montmul(const bint_soa* l, const bint_soa* r, const bint_soa* m,
+                     bint_soa* res);
+
+/// A bigint whose blocks live in a file, mapped into memory, for numbers
+/// larger than RAM. The file holds the magnitude as raw blocks, least
+/// significant first, so it must be reopened with the same block size. v is
+/// a view of the blocks (see BINT_view) and can be an operand of any
+/// function that takes a const bigint*. Only the BINT_file_ functions
+/// below write to it. Needs a POSIX system; define BINT_NO_FILES to build
+/// without it, and then BINT_file_open fails.
+typedef struct {
+    bigint v;   /* a view of the blocks in the file */
+    size_t cap; /* blocks the file and its mapping hold */
+    int fd;
+    char* path; /* scratch files are made next to it */
+} bint_file;
+
+/// Opens the file at path, or creates it empty (the value 0). Returns NULL
+/// on failure.
+bint_file* BINT_file_open(const char* path);
+/// Cuts the file down to the blocks of v, unmaps it and frees f.
+/// @returns the status. 0 for success, 1 for failure.
+int BINT_file_close(bint_file* f);
+/// Grows the file to hold at least n blocks. This moves v's blocks.
+/// @returns the status. 0 for success, 1 for failure.
+int BINT_file_reserve(bint_file* f, size_t n);
+/// Copies a into the file.
+/// @returns the status. 0 for success, 1 for failure.
+int BINT_file_set(bint_file* f, const bigint* a);
+/**
+ * @brief Out-of-core arithmetic into a file, in passes over runs of
+ * BINT_FILE_CHUNK blocks that read the next run ahead. r may be a or b,
+ * or either may be some other bint_file's v.
+ *
+ * BINT_file_add adds the magnitudes, like BINT_add. BINT_file_shl and
+ * BINT_file_shr shift the file's own value in place. BINT_file_mul runs a
+ * three-prime NTT whose residues live in a scratch file next to r's, four
+ * words for each 64-bit word of the product (rounded up to a power of two
+ * words), or three when squaring. Each transform is split into transforms
+ * of rows and of columns (the four-step method), so it only holds a row or
+ * a panel of BINT_FILE_PANEL columns in memory at a time. It needs 128-bit
+ * integers, like the in-memory NTT.
+ *
+ * @return the return code. 0 for success, 1 for failure.
+ */
+int BINT_file_add(bint_file* r, const bigint* a, const bigint* b);
+int BINT_file_shl(bint_file* f, size_t nbit);
+int BINT_file_shr(bint_file* f, size_t nbit);
+int BINT_file_mul(bint_file* r, const bigint* a, const bigint* b);
+
+/// Low-level functions on spans of blocks, like GMP's mpn layer, to build
+/// algorithms on parts of numbers. Blocks are least significant first and
+/// sizes are in blocks. They never allocate and ignore signs. rp (qp) may be
+/// the same span as an input, but must not partly overlap one.
+
+/// rp = ap + bp. Returns the carry out, 0 or 1.
+bint_blk_type BINT_add_n(bint_blk_type* rp, const bint_blk_type* ap,
+                         const bint_blk_type* bp, size_t n);
+/// rp = ap - bp. Returns the borrow out, 0 or 1.
+bint_blk_type BINT_sub_n(bint_blk_type* rp, const bint_blk_type* ap,
+                         const bint_blk_type* bp, size_t n);
+/// rp = ap * m. Returns the high block of the product.
+bint_blk_type BINT_mul_1(bint_blk_type* rp, const bint_blk_type* ap, size_t n,
+                         bint_blk_type m);
+/// rp += ap * m. Returns the carry block.
+bint_blk_type BINT_addmul_1(bint_blk_type* rp, const bint_blk_type* ap,
+                            size_t n, bint_blk_type m);
+/// rp -= ap * m. Returns the borrow block.
+bint_blk_type BINT_submul_1(bint_blk_type* rp, const bint_blk_type* ap,
+                            size_t n, bint_blk_type m);
+/// rp = ap << cnt, for n >= 1 and 0 < cnt < BINT_BLK_BIT_SZ. rp may
+/// overlap ap if rp >= ap. Returns the bits shifted out, in the low bits of
+/// the result.
+bint_blk_type BINT_lshift(bint_blk_type* rp, const bint_blk_type* ap,
+                          size_t n, unsigned cnt);
+/// rp = ap >> cnt, for n >= 1 and 0 < cnt < BINT_BLK_BIT_SZ. rp may
+/// overlap ap if rp <= ap. Returns the bits shifted out, in the high bits
+/// of the result.
+bint_blk_type BINT_rshift(bint_blk_type* rp, const bint_blk_type* ap,
+                          size_t n, unsigned cnt);
+/// Compares ap and bp. Returns 1, 0 or -1.
+int BINT_cmp_n(const bint_blk_type* ap, const bint_blk_type* bp, size_t n);
+/// qp = ap / d, d != 0. Returns the remainder.
+bint_blk_type BINT_divrem_1(bint_blk_type* qp, const bint_blk_type* ap,
+                            size_t n, bint_blk_type d);
+
 void _bint_init_with_size(bigint* bi, size_t n, void* val);
+/// Sets the length of bi to n blocks. The storage grows geometrically, so
+/// growing one block at a time is amortized O(1). New blocks are not
+/// initialized.
+int _bint_resize(bigint* bi, size_t n);
 
 #endif
\ No newline at end of file
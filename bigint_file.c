@@ -0,0 +1,160 @@
+// mmap, mkstemp and posix_madvise are POSIX
+#define _POSIX_C_SOURCE 200809L
+
+#include "bigint_kern.h"
+
+/// File-backed bigints. The blocks live in a file mapped shared into
+/// memory, so the page cache holds the part that is in use and the kernel
+/// writes the rest back to the file. Every function here keeps f->v a view
+/// of the whole mapping, so it can be read like any bigint.
+
+#if !defined(BINT_NO_FILES) && (defined(__unix__) || defined(__APPLE__))
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// Maps size bytes of fd, read and write. Returns NULL on failure.
+static void* _bint_map(int fd, size_t size) {
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) return NULL;
+    // the out-of-core functions read and write the blocks front to back
+    posix_madvise(p, size, POSIX_MADV_SEQUENTIAL);
+    return p;
+}
+
+bint_file* BINT_file_open(const char* path) {
+    size_t len = strlen(path) + 1;
+    bint_file* f = (bint_file*)_bint_alloc(sizeof(bint_file));
+    if (!f) return NULL;
+    f->path = (char*)_bint_alloc(len);
+    if (!f->path) goto ERROR;
+    memcpy(f->path, path, len);
+    f->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (f->fd < 0) goto ERROR;
+    struct stat st;
+    if (fstat(f->fd, &st)) goto ERROR;
+    size_t n = (size_t)st.st_size / BINT_BLK_SZ;
+    // there is always a block mapped, so a 0 can be stored
+    f->cap = MAX(n, 1);
+    if ((size_t)st.st_size < BINT_BLK_SZ * f->cap &&
+        ftruncate(f->fd, (off_t)(BINT_BLK_SZ * f->cap))) {
+        goto ERROR;
+    }
+    bint_blk_type* p = (bint_blk_type*)_bint_map(f->fd, BINT_BLK_SZ * f->cap);
+    if (!p) goto ERROR;
+    BINT_view(&f->v, p, n);
+    return f;
+
+ERROR:
+    if (f->path) {
+        if (f->fd >= 0) close(f->fd);
+        _bint_free(f->path, len);
+    }
+    _bint_free(f, sizeof(bint_file));
+    return NULL;
+}
+
+int BINT_file_reserve(bint_file* f, size_t n) {
+    if (n <= f->cap) return 0;
+    if (ftruncate(f->fd, (off_t)(BINT_BLK_SZ * n))) return 1;
+    // map the new size before dropping the old mapping, so a failure leaves
+    // f as it was
+    bint_blk_type* p = (bint_blk_type*)_bint_map(f->fd, BINT_BLK_SZ * n);
+    if (!p) return 1;
+    munmap(f->v.data, BINT_BLK_SZ * f->cap);
+    f->v.data = p;
+    f->cap = n;
+    return 0;
+}
+
+int BINT_file_set(bint_file* f, const bigint* a) {
+    if (BINT_file_reserve(f, MAX(a->n, 1))) return 1;
+    // a may be f->v, or a view into the same mapping
+    if (a->data != f->v.data) {
+        memmove(f->v.data, a->data, BINT_BLK_SZ * a->n);
+    }
+    if (!a->n) f->v.data[0] = 0;
+    f->v.n = MAX(a->n, 1);
+    f->v.flags = a->flags;
+    return BINT_rlz(&f->v);
+}
+
+int BINT_file_close(bint_file* f) {
+    int err = munmap(f->v.data, BINT_BLK_SZ * f->cap) != 0;
+    err |= ftruncate(f->fd, (off_t)(BINT_BLK_SZ * f->v.n)) != 0;
+    err |= close(f->fd) != 0;
+    _bint_free(f->path, strlen(f->path) + 1);
+    _bint_free(f, sizeof(bint_file));
+    return err;
+}
+
+void _bint_file_willneed(const void* p, size_t size) {
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t lo = (uintptr_t)p & ~(page - 1);
+    if (size) {
+        posix_madvise((void*)lo, (uintptr_t)p + size - lo,
+                      POSIX_MADV_WILLNEED);
+    }
+}
+
+void* _bint_file_scratch(const bint_file* f, size_t size) {
+    static const char suffix[] = ".XXXXXX";
+    size_t len = strlen(f->path);
+    char* name = (char*)_bint_alloc(len + sizeof(suffix));
+    if (!name) return NULL;
+    memcpy(name, f->path, len);
+    memcpy(name + len, suffix, sizeof(suffix));
+    void* p = NULL;
+    int fd = mkstemp(name);
+    if (fd >= 0) {
+        // the mapping keeps the file alive until it is unmapped
+        unlink(name);
+        if (!ftruncate(fd, (off_t)size)) p = _bint_map(fd, size);
+        close(fd);
+    }
+    _bint_free(name, len + sizeof(suffix));
+    return p;
+}
+
+void _bint_file_unmap(void* p, size_t size) { munmap(p, size); }
+
+#else
+
+bint_file* BINT_file_open(const char* path) {
+    (void)path;
+    return NULL;
+}
+
+int BINT_file_reserve(bint_file* f, size_t n) { return n > f->cap; }
+
+int BINT_file_set(bint_file* f, const bigint* a) {
+    (void)f;
+    (void)a;
+    return 1;
+}
+
+int BINT_file_close(bint_file* f) {
+    (void)f;
+    return 1;
+}
+
+void _bint_file_willneed(const void* p, size_t size) {
+    (void)p;
+    (void)size;
+}
+
+void* _bint_file_scratch(const bint_file* f, size_t size) {
+    (void)f;
+    (void)size;
+    return NULL;
+}
+
+void _bint_file_unmap(void* p, size_t size) {
+    (void)p;
+    (void)size;
+}
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef BIGINT_KERN_H
+#define BIGINT_KERN_H
+
+/// Internal header. The hot inner loops of the library are called through
+/// the function pointers in _bint_kern, which are pointed at the fastest
+/// variant the running CPU supports the first time the library is loaded.
+
+#include "bigint.h"
+
+/// The SIMD kernels in bigint_vec.c are built for x86 with GCC or Clang
+/// target attributes. Define BINT_NO_SIMD to build without them.
+#if !defined(BINT_NO_SIMD) && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define BINT_HAVE_X86_SIMD
+#endif
+
+/// Allocation through the hooks set by BINT_set_memory_functions.
+void* _bint_alloc(size_t size);
+void* _bint_realloc(void* p, size_t old_size, size_t new_size);
+void _bint_free(void* p, size_t size);
+
+/// The scratch arena. Temporaries are bumped off a per-thread stack of
+/// chunks and released together by going back to a position taken before
+/// allocating them. Every function that allocates scratch memory releases
+/// it before returning, so the arena is empty after each top-level
+/// operation and the chunks are kept for the next one.
+typedef struct {
+    void* chunk;
+    size_t top;
+} _bint_tmp_pos;
+
+_bint_tmp_pos _bint_tmp_mark(void);
+/// Returns size bytes of scratch memory, at a multiple of 64 bytes into its
+/// chunk. The chunk is only as aligned as the allocator makes it.
+void* _bint_tmp_alloc(size_t size);
+void _bint_tmp_release(_bint_tmp_pos pos);
+
+/// Fork-join on the thread pool of bigint_pool.c. A caller begins a join,
+/// forks tasks on it and joins it before using their results or returning;
+/// the tasks and the join live in its stack frame until then. Each task
+/// runs on some thread with that thread's scratch arena, and releases what
+/// it takes from it.
+typedef struct {
+    size_t pending; /* forked tasks that have not finished */
+    bool par;       /* whether to fork at all */
+} _bint_join;
+
+typedef struct _bint_task {
+    void (*fn)(struct _bint_task* t);
+    _bint_join* join;
+} _bint_task;
+
+/// Begins a join for work on n-block operands. par is set when the pool is
+/// running and n is at least BINT_MUL_PARALLEL_THRESHOLD; if it is not, the
+/// caller should do the work itself instead of forking.
+void _bint_par_begin(_bint_join* j, size_t n);
+/// Queues t to run on the pool (or runs it now if the queue is full).
+void _bint_par_fork(_bint_join* j, _bint_task* t);
+/// Waits until the tasks forked on j have finished, running queued tasks
+/// meanwhile.
+void _bint_par_join(_bint_join* j);
+
+/// Calls fn(arg, lo, hi) on chunks of at most chunk indices covering
+/// [0, n), spread over the pool's threads, and returns when all are done.
+typedef void (*_bint_range_fn)(void* arg, size_t lo, size_t hi);
+void _bint_par_range(size_t n, size_t chunk, _bint_range_fn fn, void* arg);
+
+/// Hints that [p, p + size) will be read soon, so the pages of a mapped
+/// file can be read ahead.
+void _bint_file_willneed(const void* p, size_t size);
+/// Maps a scratch file of size bytes, made next to f's file and removed at
+/// once, so it goes away when it is unmapped. Returns NULL on failure.
+void* _bint_file_scratch(const bint_file* f, size_t size);
+void _bint_file_unmap(void* p, size_t size);
+
+/// rp[0..n) = ap[0..n) + bp[0..n). Returns the carry out.
+typedef bint_blk_type (*_bint_add_n_fn)(bint_blk_type* rp,
+                                        const bint_blk_type* ap,
+                                        const bint_blk_type* bp, size_t n);
+/// Shift ap[0..n) by 0 < cnt < BINT_BLK_BIT_SZ bits into rp. lshift runs
+/// from the top and rshift from the bottom, so rp may overlap ap if it is
+/// above ap for lshift, or below it for rshift. Returns the bits shifted
+/// out.
+typedef bint_blk_type (*_bint_shift_fn)(bint_blk_type* rp,
+                                        const bint_blk_type* ap, size_t n,
+                                        unsigned cnt);
+/// rp[0..n) += ap[0..n) * m. Returns the carry block.
+typedef bint_blk_type (*_bint_addmul_1_fn)(bint_blk_type* rp,
+                                           const bint_blk_type* ap, size_t n,
+                                           bint_blk_type m);
+/// rp[0..an+bn) = ap[0..an) * bp[0..bn), bn <= an.
+typedef void (*_bint_mul_basecase_fn)(bint_blk_type* rp,
+                                      const bint_blk_type* ap, size_t an,
+                                      const bint_blk_type* bp, size_t bn);
+
+/// The kernels of bint_soa batches. Every lane of a vector holds a 32-bit
+/// limb of a different number in 64 bits, and limb j of the numbers is at
+/// [j * stride]. They work on all stride lanes.
+/// rp[0..rl) = the low rl limbs of ap[0..al) + bp[0..bl), or of the
+/// product. rp may be ap or bp.
+typedef void (*_bint_soa_fn)(uint64_t* rp, size_t rl, const uint64_t* ap,
+                             size_t al, const uint64_t* bp, size_t bl,
+                             size_t stride);
+/// rp[0..n) = ap * bp / 2^(32n) mod mp, for odd mp and ap, bp < mp. mi has
+/// -mp^-1 mod 2^32 of each lane. rp may be ap or bp.
+typedef void (*_bint_soa_mont_fn)(uint64_t* rp, const uint64_t* ap,
+                                  const uint64_t* bp, const uint64_t* mp,
+                                  const uint64_t* mi, size_t n,
+                                  size_t stride);
+
+/// Writes the 2 * BINT_BLK_SZ hex digits of each of ap[0..n), most
+/// significant first, to out.
+typedef void (*_bint_to_hex_fn)(char* out, const bint_blk_type* ap,
+                                size_t n);
+/// Parses 2 * BINT_BLK_SZ * n hex digits, most significant first, into
+/// rp[0..n). Returns 1 if any of them is not a hex digit.
+typedef int (*_bint_from_hex_fn)(bint_blk_type* rp, const char* s, size_t n);
+
+typedef struct {
+    _bint_add_n_fn add_n;
+    _bint_shift_fn lshift;
+    _bint_shift_fn rshift;
+    _bint_addmul_1_fn addmul_1;
+    _bint_mul_basecase_fn mul_basecase;
+    /// BINT_mul's cutoff to Karatsuba, which depends on mul_basecase.
+    size_t karatsuba_threshold;
+    /// BINT_sqr's cutoff to Karatsuba, and the size from which smaller
+    /// squares go through mul_basecase instead of the scalar squaring
+    /// kernel (once mul_basecase is SIMD).
+    size_t sqr_karatsuba_threshold;
+    size_t sqr_basecase_threshold;
+    /// BINT_powmod's cutoff to multiplication-based Montgomery reduction,
+    /// which depends on mul_basecase too.
+    size_t redc_threshold;
+    _bint_soa_fn soa_add;
+    _bint_soa_fn soa_mul;
+    _bint_soa_mont_fn soa_montmul;
+    _bint_to_hex_fn to_hex;
+    _bint_from_hex_fn from_hex;
+} _bint_kernels;
+
+extern _bint_kernels _bint_kern;
+
+#ifdef BINT_HAVE_X86_SIMD
+bint_blk_type _bint_add_n_avx2(bint_blk_type* rp, const bint_blk_type* ap,
+                               const bint_blk_type* bp, size_t n);
+bint_blk_type _bint_lshift_avx2(bint_blk_type* rp, const bint_blk_type* ap,
+                                size_t n, unsigned cnt);
+bint_blk_type _bint_rshift_avx2(bint_blk_type* rp, const bint_blk_type* ap,
+                                size_t n, unsigned cnt);
+
+bint_blk_type _bint_add_n_avx512(bint_blk_type* rp, const bint_blk_type* ap,
+                                 const bint_blk_type* bp, size_t n);
+bint_blk_type _bint_lshift_avx512(bint_blk_type* rp, const bint_blk_type* ap,
+                                  size_t n, unsigned cnt);
+bint_blk_type _bint_rshift_avx512(bint_blk_type* rp, const bint_blk_type* ap,
+                                  size_t n, unsigned cnt);
+
+/// The bint_soa kernels, on 4 and 8 lanes at a time.
+void _bint_soa_add_avx2(uint64_t* rp, size_t rl, const uint64_t* ap,
+                        size_t al, const uint64_t* bp, size_t bl,
+                        size_t stride);
+void _bint_soa_mul_avx2(uint64_t* rp, size_t rl, const uint64_t* ap,
+                        size_t al, const uint64_t* bp, size_t bl,
+                        size_t stride);
+void _bint_soa_montmul_avx2(uint64_t* rp, const uint64_t* ap,
+                            const uint64_t* bp, const uint64_t* mp,
+                            const uint64_t* mi, size_t n, size_t stride);
+void _bint_soa_add_avx512(uint64_t* rp, size_t rl, const uint64_t* ap,
+                          size_t al, const uint64_t* bp, size_t bl,
+                          size_t stride);
+void _bint_soa_mul_avx512(uint64_t* rp, size_t rl, const uint64_t* ap,
+                          size_t al, const uint64_t* bp, size_t bl,
+                          size_t stride);
+void _bint_soa_montmul_avx512(uint64_t* rp, const uint64_t* ap,
+                              const uint64_t* bp, const uint64_t* mp,
+                              const uint64_t* mi, size_t n, size_t stride);
+
+/// Hex digits with 128-bit byte shuffles, which AVX2 CPUs all have.
+void _bint_to_hex_avx2(char* out, const bint_blk_type* ap, size_t n);
+int _bint_from_hex_avx2(bint_blk_type* rp, const char* s, size_t n);
+
+#ifndef BINT_BLK_64
+/// There are no 64x64-bit vector multiplies, so these are 32-bit only.
+bint_blk_type _bint_addmul_1_avx2(bint_blk_type* rp, const bint_blk_type* ap,
+                                  size_t n, bint_blk_type m);
+bint_blk_type _bint_addmul_1_avx512(bint_blk_type* rp,
+                                    const bint_blk_type* ap, size_t n,
+                                    bint_blk_type m);
+void _bint_mul_basecase_avx2(bint_blk_type* rp, const bint_blk_type* ap,
+                             size_t an, const bint_blk_type* bp, size_t bn);
+void _bint_mul_basecase_avx512(bint_blk_type* rp, const bint_blk_type* ap,
+                               size_t an, const bint_blk_type* bp, size_t bn);
+#endif
+
+/// Needs AVX512-IFMA. Works on either block size, in radix 2^52.
+void _bint_mul_basecase_ifma(bint_blk_type* rp, const bint_blk_type* ap,
+                             size_t an, const bint_blk_type* bp, size_t bn);
+#endif
+
+#endif
@@ -0,0 +1,246 @@
+#include "bigint_kern.h"
+
+/// A work-stealing thread pool for the recursive multiplications. Every
+/// thread has a deque of tasks: it pushes and pops its own at the bottom,
+/// and idle threads steal from the top of the others', which holds the
+/// oldest and so largest subproducts. Threads outside the pool share deque
+/// 0. A thread waiting for its tasks runs queued ones instead of blocking,
+/// so a join never deadlocks.
+
+#ifndef BINT_NO_THREADS
+
+#include <pthread.h>
+#include <sched.h>
+
+/// Tasks a deque holds. A full deque runs new tasks on the spot.
+#define BINT_POOL_DEQUE_SZ 256
+
+typedef struct {
+    pthread_mutex_t lock;
+    size_t top, bot; /* the tasks are t[top..bot), modulo the size */
+    _bint_task* t[BINT_POOL_DEQUE_SZ];
+} _bint_deque;
+
+static struct {
+    unsigned n;      /* threads, counting the callers; 0 or 1 if off */
+    _bint_deque* dq; /* n deques, dq[i] for worker i */
+    pthread_t* th;   /* the workers, th[1..n) */
+    pthread_mutex_t lock;
+    pthread_cond_t cv; /* idle workers sleep here */
+    size_t queued;     /* tasks in all deques */
+    bool stop;
+} _bint_pool = {0, NULL, NULL, PTHREAD_MUTEX_INITIALIZER,
+                PTHREAD_COND_INITIALIZER, 0, false};
+
+/// The deque of the calling thread.
+static _Thread_local unsigned _bint_pool_self;
+
+static _bint_task* _bint_pool_pop(unsigned i) {
+    _bint_deque* d = &_bint_pool.dq[i];
+    _bint_task* t = NULL;
+    pthread_mutex_lock(&d->lock);
+    if (d->bot != d->top) t = d->t[--d->bot % BINT_POOL_DEQUE_SZ];
+    pthread_mutex_unlock(&d->lock);
+    return t;
+}
+
+static _bint_task* _bint_pool_steal(unsigned i) {
+    _bint_deque* d = &_bint_pool.dq[i];
+    _bint_task* t = NULL;
+    pthread_mutex_lock(&d->lock);
+    if (d->bot != d->top) t = d->t[d->top++ % BINT_POOL_DEQUE_SZ];
+    pthread_mutex_unlock(&d->lock);
+    return t;
+}
+
+/// Takes a task from the calling thread's deque, or steals one. Returns
+/// NULL if there is none.
+static _bint_task* _bint_pool_take(void) {
+    if (!__atomic_load_n(&_bint_pool.queued, __ATOMIC_ACQUIRE)) return NULL;
+    unsigned self = _bint_pool_self, n = _bint_pool.n;
+    _bint_task* t = _bint_pool_pop(self);
+    for (unsigned k = 1; !t && k < n; k++) {
+        t = _bint_pool_steal((self + k) % n);
+    }
+    if (t) __atomic_fetch_sub(&_bint_pool.queued, 1, __ATOMIC_RELAXED);
+    return t;
+}
+
+static void _bint_pool_run(_bint_task* t) {
+    _bint_join* j = t->join;
+    t->fn(t);
+    // t may be gone once the join sees the count drop
+    __atomic_fetch_sub(&j->pending, 1, __ATOMIC_RELEASE);
+}
+
+static void* _bint_pool_worker(void* arg) {
+    _bint_pool_self = (unsigned)(uintptr_t)arg;
+    for (;;) {
+        _bint_task* t = _bint_pool_take();
+        if (t) {
+            _bint_pool_run(t);
+            continue;
+        }
+        pthread_mutex_lock(&_bint_pool.lock);
+        while (!_bint_pool.stop &&
+               !__atomic_load_n(&_bint_pool.queued, __ATOMIC_ACQUIRE)) {
+            pthread_cond_wait(&_bint_pool.cv, &_bint_pool.lock);
+        }
+        bool stop = _bint_pool.stop;
+        pthread_mutex_unlock(&_bint_pool.lock);
+        if (stop) break;
+    }
+    BINT_free_scratch();
+    return NULL;
+}
+
+static void _bint_pool_stop(void) {
+    pthread_mutex_lock(&_bint_pool.lock);
+    _bint_pool.stop = true;
+    pthread_cond_broadcast(&_bint_pool.cv);
+    pthread_mutex_unlock(&_bint_pool.lock);
+    for (unsigned i = 1; i < _bint_pool.n; i++) {
+        pthread_join(_bint_pool.th[i], NULL);
+    }
+    for (unsigned i = 0; i < _bint_pool.n; i++) {
+        pthread_mutex_destroy(&_bint_pool.dq[i].lock);
+    }
+    _bint_free(_bint_pool.dq, sizeof(_bint_deque) * _bint_pool.n);
+    _bint_free(_bint_pool.th, sizeof(pthread_t) * _bint_pool.n);
+    _bint_pool.dq = NULL;
+    _bint_pool.th = NULL;
+    _bint_pool.n = 0;
+    _bint_pool.stop = false;
+}
+
+int BINT_set_threads(unsigned n) {
+    if (n == MAX(_bint_pool.n, 1)) return 0;
+    if (_bint_pool.n) _bint_pool_stop();
+    if (n <= 1) return 0;
+
+    _bint_pool.dq = (_bint_deque*)_bint_alloc(sizeof(_bint_deque) * n);
+    _bint_pool.th = (pthread_t*)_bint_alloc(sizeof(pthread_t) * n);
+    if (!_bint_pool.dq || !_bint_pool.th) goto ERROR;
+    for (unsigned i = 0; i < n; i++) {
+        pthread_mutex_init(&_bint_pool.dq[i].lock, NULL);
+        _bint_pool.dq[i].top = _bint_pool.dq[i].bot = 0;
+    }
+    // n is set first so that the workers see all the deques
+    _bint_pool.n = n;
+    for (unsigned i = 1; i < n; i++) {
+        if (pthread_create(&_bint_pool.th[i], NULL, _bint_pool_worker,
+                           (void*)(uintptr_t)i)) {
+            _bint_pool.n = i;
+            _bint_pool_stop();
+            return 1;
+        }
+    }
+    return 0;
+
+ERROR:
+    if (_bint_pool.dq) _bint_free(_bint_pool.dq, sizeof(_bint_deque) * n);
+    if (_bint_pool.th) _bint_free(_bint_pool.th, sizeof(pthread_t) * n);
+    _bint_pool.dq = NULL;
+    _bint_pool.th = NULL;
+    return 1;
+}
+
+unsigned BINT_get_threads(void) { return MAX(_bint_pool.n, 1); }
+
+void _bint_par_begin(_bint_join* j, size_t n) {
+    j->pending = 0;
+    j->par = _bint_pool.n > 1 && n >= BINT_MUL_PARALLEL_THRESHOLD;
+}
+
+void _bint_par_fork(_bint_join* j, _bint_task* t) {
+    // a task forked more than once may already be running elsewhere
+    if (t->join != j) t->join = j;
+    _bint_deque* d = &_bint_pool.dq[_bint_pool_self];
+    pthread_mutex_lock(&d->lock);
+    bool full = d->bot - d->top == BINT_POOL_DEQUE_SZ;
+    if (!full) {
+        __atomic_fetch_add(&j->pending, 1, __ATOMIC_RELAXED);
+        d->t[d->bot++ % BINT_POOL_DEQUE_SZ] = t;
+        __atomic_fetch_add(&_bint_pool.queued, 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&d->lock);
+    if (full) {
+        t->fn(t);
+        return;
+    }
+    pthread_mutex_lock(&_bint_pool.lock);
+    pthread_cond_signal(&_bint_pool.cv);
+    pthread_mutex_unlock(&_bint_pool.lock);
+}
+
+void _bint_par_join(_bint_join* j) {
+    while (__atomic_load_n(&j->pending, __ATOMIC_ACQUIRE)) {
+        _bint_task* t = _bint_pool_take();
+        if (t) {
+            _bint_pool_run(t);
+        } else {
+            sched_yield();
+        }
+    }
+}
+
+/// A loop over [0, n) split into chunks. The same job is forked once per
+/// thread, and every copy takes chunks off the shared counter until none
+/// are left, so fast threads simply take more of them.
+typedef struct {
+    _bint_task task;
+    _bint_range_fn fn;
+    void* arg;
+    size_t next; /* the first index not taken yet */
+    size_t n, chunk;
+} _bint_range_job;
+
+static void _bint_range_run(_bint_task* t) {
+    _bint_range_job* job = (_bint_range_job*)t;
+    size_t lo;
+    while ((lo = __atomic_fetch_add(&job->next, job->chunk,
+                                    __ATOMIC_RELAXED)) < job->n) {
+        job->fn(job->arg, lo, MIN(lo + job->chunk, job->n));
+    }
+}
+
+void _bint_par_range(size_t n, size_t chunk, _bint_range_fn fn, void* arg) {
+    size_t chunks = (n + chunk - 1) / chunk;
+    if (_bint_pool.n <= 1 || chunks <= 1) {
+        if (n) fn(arg, 0, n);
+        return;
+    }
+    _bint_join jn = {0, true};
+    _bint_range_job job = {{_bint_range_run, &jn}, fn, arg, 0, n, chunk};
+    for (size_t i = 1; i < MIN(chunks, _bint_pool.n); i++) {
+        _bint_par_fork(&jn, &job.task);
+    }
+    _bint_range_run(&job.task);
+    _bint_par_join(&jn);
+}
+
+#else
+
+int BINT_set_threads(unsigned n) { return n > 1; }
+
+unsigned BINT_get_threads(void) { return 1; }
+
+void _bint_par_begin(_bint_join* j, size_t n) {
+    (void)n;
+    j->pending = 0;
+    j->par = false;
+}
+
+void _bint_par_fork(_bint_join* j, _bint_task* t) {
+    t->join = j;
+    t->fn(t);
+}
+
+void _bint_par_join(_bint_join* j) { (void)j; }
+
+void _bint_par_range(size_t n, size_t chunk, _bint_range_fn fn, void* arg) {
+    (void)chunk;
+    if (n) fn(arg, 0, n);
+}
+
+#endif
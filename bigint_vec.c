@@ -1,503 +1,867 @@
+#include "bigint_kern.h"
+
+#ifdef BINT_HAVE_X86_SIMD
+
 #include <immintrin.h>
 
-#include "bigint.h"
-#include "strbuf.h"
 #include "string.h"
 
-uint32_t _bint_10_exp(int x) {
-    switch (x) {
-        case 0:
-            return 1u;
-        case 1:
-            return 10u;
-        case 2:
-            return 100u;
-        case 3:
-            return 1000u;
-        case 4:
-            return 10000u;
-        case 5:
-            return 100000u;
-        case 6:
-            return 1000000u;
-        case 7:
-            return 10000000u;
-        case 8:
-            return 100000000u;
-        case 9:
-            return 1000000000u;
-    }
-    return 1;
+/// SIMD variants of the kernels in bint_kern. Each function is compiled for
+/// its own instruction set with a target attribute, so this file builds
+/// without -mavx2 and is only entered when the CPU supports it.
+
+#define BINT_AVX2 __attribute__((target("avx2")))
+#define BINT_AVX512 __attribute__((target("avx512f")))
+#define BINT_IFMA __attribute__((target("avx512f,avx512ifma")))
+
+// lane-width specific intrinsics
+#ifdef BINT_BLK_64
+#define V2_LANES 4
+#define V2_SET1(x) _mm256_set1_epi64x((long long)(x))
+#define V2_LANE_IDX _mm256_setr_epi64x(0, 1, 2, 3)
+#define V2_ADD _mm256_add_epi64
+#define V2_CMPGT _mm256_cmpgt_epi64
+#define V2_CMPEQ _mm256_cmpeq_epi64
+#define V2_SLL _mm256_sll_epi64
+#define V2_SRL _mm256_srl_epi64
+#define V2_SRLV _mm256_srlv_epi64
+#define V2_MOVEMASK(v) _mm256_movemask_pd(_mm256_castsi256_pd(v))
+#define V5_LANES 8
+#define V5_SET1(x) _mm512_set1_epi64((long long)(x))
+#define V5_CMPLT_MASK _mm512_cmplt_epu64_mask
+#define V5_CMPEQ_MASK _mm512_cmpeq_epi64_mask
+#define V5_ADD _mm512_add_epi64
+#define V5_MASK_SUB _mm512_mask_sub_epi64
+#define V5_SLL _mm512_sll_epi64
+#define V5_SRL _mm512_srl_epi64
+#else
+#define V2_LANES 8
+#define V2_SET1(x) _mm256_set1_epi32((int)(x))
+#define V2_LANE_IDX _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)
+#define V2_ADD _mm256_add_epi32
+#define V2_CMPGT _mm256_cmpgt_epi32
+#define V2_CMPEQ _mm256_cmpeq_epi32
+#define V2_SLL _mm256_sll_epi32
+#define V2_SRL _mm256_srl_epi32
+#define V2_SRLV _mm256_srlv_epi32
+#define V2_MOVEMASK(v) _mm256_movemask_ps(_mm256_castsi256_ps(v))
+#define V5_LANES 16
+#define V5_SET1(x) _mm512_set1_epi32((int)(x))
+#define V5_CMPLT_MASK _mm512_cmplt_epu32_mask
+#define V5_CMPEQ_MASK _mm512_cmpeq_epi32_mask
+#define V5_ADD _mm512_add_epi32
+#define V5_MASK_SUB _mm512_mask_sub_epi32
+#define V5_SLL _mm512_sll_epi32
+#define V5_SRL _mm512_srl_epi32
+#endif
+
+/// Resolves the carries of one vector of lane sums. g has the lanes that
+/// overflowed, p the lanes that are all ones (and pass a carry through).
+/// Returns the mask of lanes that receive a carry; *c is the carry in on
+/// entry and the carry out on return.
+static inline unsigned _bint_carry_mask(unsigned g, unsigned p, unsigned* c,
+                                        unsigned lanes) {
+    unsigned t = ((g << 1) | *c) + p;
+    *c = t >> lanes;
+    return (t ^ p) & ((1u << lanes) - 1);
 }
 
-bigint* BINT_make() {
-    bigint* bi = (bigint*)malloc(sizeof(bigint));
-    bi->n = 0;
-    bi->data = NULL;
-    bi->flags = 0;
-    return bi;
+static inline bint_blk_type _bint_add_n_tail(bint_blk_type* rp,
+                                             const bint_blk_type* ap,
+                                             const bint_blk_type* bp, size_t n,
+                                             bint_blk_type carry) {
+    bint_blk_type a, s;
+    for (size_t i = 0; i < n; i++) {
+        a = ap[i];
+        s = a + bp[i];
+        rp[i] = s + carry;
+        carry = (s < a) | (rp[i] < s);
+    }
+    return carry;
 }
 
-bigint* BINT_zero() {
-    bigint* bi = (bigint*)malloc(sizeof(bigint));
-    _bint_init_with_size(bi, 1, NULL);
-    bi->data[0] = 0;
-    return bi;
+BINT_AVX2 bint_blk_type _bint_add_n_avx2(bint_blk_type* rp,
+                                         const bint_blk_type* ap,
+                                         const bint_blk_type* bp, size_t n) {
+    const __m256i sign = V2_SET1(BINT_BLK_HIGHEST_BIT);
+    const __m256i ones = V2_SET1(BINT_BLK_MAX);
+    const __m256i idx = V2_LANE_IDX;
+    unsigned c = 0, g, p, cm;
+    size_t i = 0;
+    for (; i + V2_LANES <= n; i += V2_LANES) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(ap + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(bp + i));
+        __m256i s = V2_ADD(a, b);
+        // unsigned s < a, by comparing with the sign bits flipped
+        g = V2_MOVEMASK(V2_CMPGT(_mm256_xor_si256(a, sign),
+                                 _mm256_xor_si256(s, sign)));
+        p = V2_MOVEMASK(V2_CMPEQ(s, ones));
+        cm = _bint_carry_mask(g, p, &c, V2_LANES);
+        // lane k gets (cm >> k) & 1 added
+        __m256i inc = _mm256_and_si256(V2_SRLV(V2_SET1(cm), idx), V2_SET1(1));
+        _mm256_storeu_si256((__m256i*)(rp + i), V2_ADD(s, inc));
+    }
+    return _bint_add_n_tail(rp + i, ap + i, bp + i, n - i, c);
 }
 
-bigint* BINT_makei(int32_t i) {
-    bigint* bi = (bigint*)malloc(sizeof(bigint));
-    if (i < 0) {
-        bi->flags = BIGINT_FLAG_NEG;
-        i = -i;
-    }
-    _bint_init_with_size(bi, 1, &i);
-    return bi;
+BINT_AVX512 bint_blk_type _bint_add_n_avx512(bint_blk_type* rp,
+                                             const bint_blk_type* ap,
+                                             const bint_blk_type* bp,
+                                             size_t n) {
+    const __m512i ones = V5_SET1(BINT_BLK_MAX);
+    unsigned c = 0, g, p, cm;
+    size_t i = 0;
+    for (; i + V5_LANES <= n; i += V5_LANES) {
+        __m512i a = _mm512_loadu_si512((const void*)(ap + i));
+        __m512i b = _mm512_loadu_si512((const void*)(bp + i));
+        __m512i s = V5_ADD(a, b);
+        g = V5_CMPLT_MASK(s, a);
+        p = V5_CMPEQ_MASK(s, ones);
+        cm = _bint_carry_mask(g, p, &c, V5_LANES);
+        // s - (-1) in the lanes that take a carry
+        s = V5_MASK_SUB(s, cm, s, ones);
+        _mm512_storeu_si512((void*)(rp + i), s);
+    }
+    return _bint_add_n_tail(rp + i, ap + i, bp + i, n - i, c);
 }
 
-bigint* BINT_makeui(uint32_t i) {
-    bigint* bi = (bigint*)malloc(sizeof(bigint));
-    _bint_init_with_size(bi, 1, &i);
-    return bi;
+// The shifts are funnel shifts of a vector with the same vector one block
+// further down. lshift runs from the top and rshift from the bottom, so
+// both can work in place, or move the blocks up and down respectively.
+
+BINT_AVX2 bint_blk_type _bint_lshift_avx2(bint_blk_type* rp,
+                                          const bint_blk_type* ap, size_t n,
+                                          unsigned cnt) {
+    const unsigned tnc = BINT_BLK_BIT_SZ - cnt;
+    const __m128i sl = _mm_cvtsi32_si128((int)cnt);
+    const __m128i sr = _mm_cvtsi32_si128((int)tnc);
+    bint_blk_type out = ap[n - 1] >> tnc;
+    size_t i = n;
+    while (i >= V2_LANES + 1) {
+        i -= V2_LANES;
+        __m256i hi = _mm256_loadu_si256((const __m256i*)(ap + i));
+        __m256i lo = _mm256_loadu_si256((const __m256i*)(ap + i - 1));
+        _mm256_storeu_si256((__m256i*)(rp + i),
+                            _mm256_or_si256(V2_SLL(hi, sl), V2_SRL(lo, sr)));
+    }
+    for (i--; i > 0; i--) rp[i] = (ap[i] << cnt) | (ap[i - 1] >> tnc);
+    rp[0] = ap[0] << cnt;
+    return out;
 }
 
-bigint* BINT_makel(int64_t l) {
-    bool neg = l < 0;
-    bigint* res = BINT_makeul((uint64_t)(neg ? -l : l));
-    res->flags |= BIGINT_FLAG_NEG;
-    return res;
+BINT_AVX2 bint_blk_type _bint_rshift_avx2(bint_blk_type* rp,
+                                          const bint_blk_type* ap, size_t n,
+                                          unsigned cnt) {
+    const unsigned tnc = BINT_BLK_BIT_SZ - cnt;
+    const __m128i sr = _mm_cvtsi32_si128((int)cnt);
+    const __m128i sl = _mm_cvtsi32_si128((int)tnc);
+    bint_blk_type out = ap[0] << tnc;
+    size_t i = 0;
+    for (; i + V2_LANES < n; i += V2_LANES) {
+        __m256i lo = _mm256_loadu_si256((const __m256i*)(ap + i));
+        __m256i hi = _mm256_loadu_si256((const __m256i*)(ap + i + 1));
+        _mm256_storeu_si256((__m256i*)(rp + i),
+                            _mm256_or_si256(V2_SRL(lo, sr), V2_SLL(hi, sl)));
+    }
+    for (; i + 1 < n; i++) rp[i] = (ap[i] >> cnt) | (ap[i + 1] << tnc);
+    rp[n - 1] = ap[n - 1] >> cnt;
+    return out;
 }
 
-bigint* BINT_makeul(uint64_t l) {
-    bigint* bi = (bigint*)malloc(sizeof(bigint));
-    _bint_init_with_size(bi, 2, &l);
-    return bi;
+BINT_AVX512 bint_blk_type _bint_lshift_avx512(bint_blk_type* rp,
+                                              const bint_blk_type* ap,
+                                              size_t n, unsigned cnt) {
+    const unsigned tnc = BINT_BLK_BIT_SZ - cnt;
+    const __m128i sl = _mm_cvtsi32_si128((int)cnt);
+    const __m128i sr = _mm_cvtsi32_si128((int)tnc);
+    bint_blk_type out = ap[n - 1] >> tnc;
+    size_t i = n;
+    while (i >= V5_LANES + 1) {
+        i -= V5_LANES;
+        __m512i hi = _mm512_loadu_si512((const void*)(ap + i));
+        __m512i lo = _mm512_loadu_si512((const void*)(ap + i - 1));
+        _mm512_storeu_si512((void*)(rp + i),
+                            _mm512_or_si512(V5_SLL(hi, sl), V5_SRL(lo, sr)));
+    }
+    for (i--; i > 0; i--) rp[i] = (ap[i] << cnt) | (ap[i - 1] >> tnc);
+    rp[0] = ap[0] << cnt;
+    return out;
 }
 
-bigint* BINT_makep(void* p, size_t size) {
-    bigint* bi = (bigint*)malloc(sizeof(bigint));
-    _bint_init_with_size(bi, size, p);
-    return bi;
+BINT_AVX512 bint_blk_type _bint_rshift_avx512(bint_blk_type* rp,
+                                              const bint_blk_type* ap,
+                                              size_t n, unsigned cnt) {
+    const unsigned tnc = BINT_BLK_BIT_SZ - cnt;
+    const __m128i sr = _mm_cvtsi32_si128((int)cnt);
+    const __m128i sl = _mm_cvtsi32_si128((int)tnc);
+    bint_blk_type out = ap[0] << tnc;
+    size_t i = 0;
+    for (; i + V5_LANES < n; i += V5_LANES) {
+        __m512i lo = _mm512_loadu_si512((const void*)(ap + i));
+        __m512i hi = _mm512_loadu_si512((const void*)(ap + i + 1));
+        _mm512_storeu_si512((void*)(rp + i),
+                            _mm512_or_si512(V5_SRL(lo, sr), V5_SLL(hi, sl)));
+    }
+    for (; i + 1 < n; i++) rp[i] = (ap[i] >> cnt) | (ap[i + 1] << tnc);
+    rp[n - 1] = ap[n - 1] >> cnt;
+    return out;
 }
 
-bigint* BINT_cp(const bigint* bi) {
-    bigint* cp = BINT_make();
-    cp->n = bi->n;
-    cp->flags = bi->flags;
-    cp->data = (bint_blk_type*)malloc(BINT_BLK_SZ * cp->n);
-    if (!cp->data) {
-        free(cp);
-        return NULL;
-    }
-    memcpy(cp->data, bi->data, BINT_BLK_SZ * cp->n);
-    return cp;
+// Hex digits. The 16 bytes of a vector, taken from the top of the number,
+// are reversed into string order, split into nibbles, looked up with a byte
+// shuffle and interleaved high nibble first into 32 digits. Parsing runs the
+// same steps backwards. The bytes below the last whole vector go through a
+// zero-padded copy.
+
+BINT_AVX2 static inline void _bint_hex16_enc(char* out, __m128i v) {
+    const __m128i rev =
+        _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    const __m128i tab = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+                                      '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    v = _mm_shuffle_epi8(v, rev);
+    __m128i hi =
+        _mm_shuffle_epi8(tab, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+    __m128i lo = _mm_shuffle_epi8(tab, _mm_and_si128(v, mask));
+    _mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128((__m128i*)(out + 16), _mm_unpackhi_epi8(hi, lo));
 }
 
-void BINT_setui(bigint* bi, uint32_t i) {
-    free(bi->data);
-    bi->n = 1;
-    bi->data = (bint_blk_type*)malloc(BINT_BLK_SZ);
-    bi->data[0] = i;
-    bi->flags &= ~BIGINT_FLAG_NEG;
+/// Parses 32 digits into 16 bytes. Sets bits of *bad for non-hex digits.
+BINT_AVX2 static inline __m128i _bint_hex16_dec(const char* s, int* bad) {
+    const __m128i rev =
+        _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    __m256i c = _mm256_loadu_si256((const __m256i*)s);
+    // setting bit 5 lowercases letters and keeps digits as they are
+    __m256i l = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+    __m256i dig =
+        _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)),
+                         _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), c));
+    __m256i alpha =
+        _mm256_and_si256(_mm256_cmpgt_epi8(l, _mm256_set1_epi8('a' - 1)),
+                         _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), l));
+    *bad |= ~_mm256_movemask_epi8(_mm256_or_si256(dig, alpha));
+    __m256i v = _mm256_blendv_epi8(
+        _mm256_sub_epi8(l, _mm256_set1_epi8('a' - 10)),
+        _mm256_sub_epi8(c, _mm256_set1_epi8('0')), dig);
+    // each pair of nibbles to hi * 16 + lo
+    __m256i w = _mm256_maddubs_epi16(v, _mm256_set1_epi16(0x0110));
+    __m128i b = _mm_packus_epi16(_mm256_castsi256_si128(w),
+                                 _mm256_extracti128_si256(w, 1));
+    return _mm_shuffle_epi8(b, rev);
 }
 
-int BINT_shl(bigint* bi, size_t nbit) {
-    int leading_zeroes = __builtin_clz(bi->data[bi->n - 1]);
-    size_t add_zero_blks = nbit / BINT_BLK_BIT_SZ;
-    nbit = nbit % BINT_BLK_BIT_SZ;
-    bool new_lead_blk = nbit > leading_zeroes;
-    size_t add_blk_cnt = add_zero_blks + new_lead_blk;
-    bint_blk_type* buf =
-        (bint_blk_type*)malloc((bi->n + add_blk_cnt) * BINT_BLK_SZ);
-    bint_blk_type carry = 0;
-    bint_blk_type cur;
-    int j = 0;
-    for (; j < add_zero_blks; j++) {
-        buf[j] = 0u;
+BINT_AVX2 void _bint_to_hex_avx2(char* out, const bint_blk_type* ap,
+                                 size_t n) {
+    const uint8_t* p = (const uint8_t*)ap;
+    size_t i = BINT_BLK_SZ * n;
+    for (; i >= 16; i -= 16, out += 32) {
+        _bint_hex16_enc(out, _mm_loadu_si128((const __m128i*)(p + i - 16)));
     }
-    for (int i = 0; i < bi->n; i++, j++) {
-        cur = bi->data[i] + carry;
-        carry = cur >> (BINT_BLK_BIT_SZ - nbit);
-        buf[j] = cur << nbit;
+    if (i) {
+        uint8_t buf[16] = {0};
+        char tmp[32];
+        memcpy(buf, p, i);
+        _bint_hex16_enc(tmp, _mm_loadu_si128((const __m128i*)buf));
+        memcpy(out, tmp + 32 - 2 * i, 2 * i);
     }
-    if (new_lead_blk) {
-        if (!carry) {
-            free(buf);
-            return 1;
-        }
-        buf[j] = carry;
-    }
-    free(bi->data);
-    bi->data = buf;
-    return 0;
 }
 
-int BINT_shl1(bigint* bi) {
-    bint_blk_type carry = 0;
-    bint_blk_type next_carry;
-    for (size_t i = 0; i < bi->n; i++) {
-        next_carry = (bi->data[i] & BINT_BLK_HIGHEST_BIT) ? 1 : 0;
-        bi->data[i] = (bi->data[i] << 1) | carry;
-        carry = next_carry;
-    }
-    if (carry) {
-        BINT_REALLOC(bi, bi->n + 1);
-        bi->data[bi->n - 1] = 1u;
-    }
-    return 0;
+BINT_AVX2 int _bint_from_hex_avx2(bint_blk_type* rp, const char* s,
+                                  size_t n) {
+    uint8_t* p = (uint8_t*)rp;
+    size_t i = BINT_BLK_SZ * n;
+    int bad = 0;
+    for (; i >= 16; i -= 16, s += 32) {
+        _mm_storeu_si128((__m128i*)(p + i - 16), _bint_hex16_dec(s, &bad));
+    }
+    if (i) {
+        char tmp[32];
+        uint8_t buf[16];
+        memset(tmp, '0', 32 - 2 * i);
+        memcpy(tmp + 32 - 2 * i, s, 2 * i);
+        _mm_storeu_si128((__m128i*)buf, _bint_hex16_dec(tmp, &bad));
+        memcpy(p, buf, i);
+    }
+    return bad != 0;
 }
 
-int BINT_shr1(bigint* bi) {
-    bint_blk_type carry = 0;
-    bint_blk_type next_carry;
-    for (size_t i = bi->n - 1; i + 1; i--) {
-        next_carry = (bi->data[i] & 1) ? BINT_BLK_HIGHEST_BIT : 0;
-        bi->data[i] = (bi->data[i] >> 1) | carry;
-        carry = next_carry;
+// The bint_soa kernels. A vector holds the same 32-bit limb of 4 or 8
+// numbers in 64-bit lanes, and the loops of the scalar kernels in bigint.c
+// run on all of them in lockstep. Products of limbs are split into low and
+// high halves that are summed separately, so carries only move between
+// columns, never between lanes.
+
+#define V2_LD(p) _mm256_loadu_si256((const __m256i*)(p))
+#define V2_ST(p, v) _mm256_storeu_si256((__m256i*)(p), v)
+#define V5_LD(p) _mm512_loadu_si512((const void*)(p))
+#define V5_ST(p, v) _mm512_storeu_si512((void*)(p), v)
+
+BINT_AVX2 void _bint_soa_add_avx2(uint64_t* rp, size_t rl, const uint64_t* ap,
+                                  size_t al, const uint64_t* bp, size_t bl,
+                                  size_t stride) {
+    const __m256i lo32 = _mm256_set1_epi64x(UINT32_MAX);
+    for (size_t g = 0; g < stride; g += 4) {
+        __m256i c = _mm256_setzero_si256();
+        for (size_t j = 0; j < rl; j++) {
+            if (j < al) c = _mm256_add_epi64(c, V2_LD(ap + j * stride + g));
+            if (j < bl) c = _mm256_add_epi64(c, V2_LD(bp + j * stride + g));
+            V2_ST(rp + j * stride + g, _mm256_and_si256(c, lo32));
+            c = _mm256_srli_epi64(c, 32);
+        }
     }
-    return BINT_rlz(bi);
 }
 
-inline void BINT_free(bigint* bi) {
-    free(bi->data);
-    free(bi);
+BINT_AVX2 void _bint_soa_mul_avx2(uint64_t* rp, size_t rl, const uint64_t* ap,
+                                  size_t al, const uint64_t* bp, size_t bl,
+                                  size_t stride) {
+    const __m256i lo32 = _mm256_set1_epi64x(UINT32_MAX);
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    uint64_t* tp = (uint64_t*)_bint_tmp_alloc(sizeof(__m256i) * rl);
+    for (size_t g = 0; g < stride; g += 4) {
+        __m256i lo = _mm256_setzero_si256(), hi, p;
+        for (size_t k = 0; k < rl; k++) {
+            size_t i0 = k >= bl ? k - bl + 1 : 0, i1 = MIN(k + 1, al);
+            hi = _mm256_setzero_si256();
+            for (size_t i = i0; i < i1; i++) {
+                p = _mm256_mul_epu32(V2_LD(ap + i * stride + g),
+                                     V2_LD(bp + (k - i) * stride + g));
+                lo = _mm256_add_epi64(lo, _mm256_and_si256(p, lo32));
+                hi = _mm256_add_epi64(hi, _mm256_srli_epi64(p, 32));
+            }
+            V2_ST(tp + 4 * k, _mm256_and_si256(lo, lo32));
+            lo = _mm256_add_epi64(_mm256_srli_epi64(lo, 32), hi);
+        }
+        for (size_t k = 0; k < rl; k++) {
+            V2_ST(rp + k * stride + g, V2_LD(tp + 4 * k));
+        }
+    }
+    _bint_tmp_release(pos);
 }
 
-inline bool BINT_isneg(const bigint* bi) { return bi->flags & BIGINT_FLAG_NEG; }
-
-bool BINT_iszero(const bigint* bi) {
-    for (size_t i = 0; i < bi->n; i++) {
-        if (bi->data[i] != 0) {
-            return false;
+BINT_AVX2 void _bint_soa_montmul_avx2(uint64_t* rp, const uint64_t* ap,
+                                      const uint64_t* bp, const uint64_t* mp,
+                                      const uint64_t* mi, size_t n,
+                                      size_t stride) {
+    const __m256i lo32 = _mm256_set1_epi64x(UINT32_MAX);
+    const __m256i one = _mm256_set1_epi64x(1);
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    uint64_t* q = (uint64_t*)_bint_tmp_alloc(sizeof(__m256i) * n);
+    for (size_t g = 0; g < stride; g += 4) {
+        const uint64_t *a = ap + g, *b = bp + g, *m = mp + g;
+        __m256i lo = _mm256_setzero_si256(), hi, p;
+        for (size_t k = 0; k < 2 * n - 1; k++) {
+            size_t i0 = k >= n ? k - n + 1 : 0, i1 = MIN(k + 1, n);
+            hi = _mm256_setzero_si256();
+            for (size_t i = i0; i < i1; i++) {
+                p = _mm256_mul_epu32(V2_LD(a + i * stride),
+                                     V2_LD(b + (k - i) * stride));
+                lo = _mm256_add_epi64(lo, _mm256_and_si256(p, lo32));
+                hi = _mm256_add_epi64(hi, _mm256_srli_epi64(p, 32));
+                if (i < k) {
+                    p = _mm256_mul_epu32(V2_LD(q + 4 * i),
+                                         V2_LD(m + (k - i) * stride));
+                    lo = _mm256_add_epi64(lo, _mm256_and_si256(p, lo32));
+                    hi = _mm256_add_epi64(hi, _mm256_srli_epi64(p, 32));
+                }
+            }
+            if (k < n) {
+                __m256i qk = _mm256_and_si256(
+                    _mm256_mul_epu32(lo, V2_LD(mi + g)), lo32);
+                V2_ST(q + 4 * k, qk);
+                p = _mm256_mul_epu32(qk, V2_LD(m));
+                lo = _mm256_add_epi64(lo, _mm256_and_si256(p, lo32));
+                hi = _mm256_add_epi64(hi, _mm256_srli_epi64(p, 32));
+            } else {
+                V2_ST(rp + (k - n) * stride + g, _mm256_and_si256(lo, lo32));
+            }
+            lo = _mm256_add_epi64(_mm256_srli_epi64(lo, 32), hi);
+        }
+        V2_ST(rp + (n - 1) * stride + g, _mm256_and_si256(lo, lo32));
+        // subtract mp in the lanes where that does not borrow, or where the
+        // result has a bit above the top limb
+        __m256i top = _mm256_srli_epi64(lo, 32), d;
+        __m256i borrow = _mm256_setzero_si256();
+        for (size_t j = 0; j < n; j++) {
+            d = _mm256_sub_epi64(V2_LD(rp + j * stride + g),
+                                 V2_LD(m + j * stride));
+            borrow = _mm256_srli_epi64(_mm256_sub_epi64(d, borrow), 63);
+        }
+        __m256i sel = _mm256_sub_epi64(
+            _mm256_setzero_si256(),
+            _mm256_or_si256(top, _mm256_xor_si256(borrow, one)));
+        borrow = _mm256_setzero_si256();
+        for (size_t j = 0; j < n; j++) {
+            __m256i r = V2_LD(rp + j * stride + g);
+            d = _mm256_sub_epi64(_mm256_sub_epi64(r, V2_LD(m + j * stride)),
+                                 borrow);
+            borrow = _mm256_srli_epi64(d, 63);
+            d = _mm256_and_si256(d, lo32);
+            V2_ST(rp + j * stride + g, _mm256_blendv_epi8(r, d, sel));
         }
     }
-    return true;
+    _bint_tmp_release(pos);
 }
 
-inline void BINT_neg(bigint* bi) { bi->flags ^= BIGINT_FLAG_NEG; }
-
-int BINT_cmp(const bigint* b1, const bigint* b2) {
-    size_t max_size = MAX(b1->n, b2->n);
-    for (size_t i = max_size - 1; i + 1; i--) {
-        bint_blk_type wa = i < b1->n ? b1->data[i] : 0;
-        bint_blk_type wb = i < b2->n ? b2->data[i] : 0;
-        if (wa != wb) {
-            return wa > wb ? 1 : -1;
+BINT_AVX512 void _bint_soa_add_avx512(uint64_t* rp, size_t rl,
+                                      const uint64_t* ap, size_t al,
+                                      const uint64_t* bp, size_t bl,
+                                      size_t stride) {
+    const __m512i lo32 = _mm512_set1_epi64(UINT32_MAX);
+    for (size_t g = 0; g < stride; g += 8) {
+        __m512i c = _mm512_setzero_si512();
+        for (size_t j = 0; j < rl; j++) {
+            if (j < al) c = _mm512_add_epi64(c, V5_LD(ap + j * stride + g));
+            if (j < bl) c = _mm512_add_epi64(c, V5_LD(bp + j * stride + g));
+            V5_ST(rp + j * stride + g, _mm512_and_si512(c, lo32));
+            c = _mm512_srli_epi64(c, 32);
         }
     }
-    return 0;
 }
 
-int BINT_rlz(bigint* b) {
-    size_t size = b->n;
-    if (size == 0 || b->data[size - 1] != 0) return 0;
-    for (size_t i = size - 2; i + 1; i--) {
-        if (b->data[i] != 0) {
-            BINT_REALLOC(b, i + 1);
-            return 0;
+BINT_AVX512 void _bint_soa_mul_avx512(uint64_t* rp, size_t rl,
+                                      const uint64_t* ap, size_t al,
+                                      const uint64_t* bp, size_t bl,
+                                      size_t stride) {
+    const __m512i lo32 = _mm512_set1_epi64(UINT32_MAX);
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    uint64_t* tp = (uint64_t*)_bint_tmp_alloc(sizeof(__m512i) * rl);
+    for (size_t g = 0; g < stride; g += 8) {
+        __m512i lo = _mm512_setzero_si512(), hi, p;
+        for (size_t k = 0; k < rl; k++) {
+            size_t i0 = k >= bl ? k - bl + 1 : 0, i1 = MIN(k + 1, al);
+            hi = _mm512_setzero_si512();
+            for (size_t i = i0; i < i1; i++) {
+                p = _mm512_mul_epu32(V5_LD(ap + i * stride + g),
+                                     V5_LD(bp + (k - i) * stride + g));
+                lo = _mm512_add_epi64(lo, _mm512_and_si512(p, lo32));
+                hi = _mm512_add_epi64(hi, _mm512_srli_epi64(p, 32));
+            }
+            V5_ST(tp + 8 * k, _mm512_and_si512(lo, lo32));
+            lo = _mm512_add_epi64(_mm512_srli_epi64(lo, 32), hi);
+        }
+        for (size_t k = 0; k < rl; k++) {
+            V5_ST(rp + k * stride + g, V5_LD(tp + 8 * k));
         }
     }
-    bint_blk_type* tmp = (bint_blk_type*)malloc(BINT_BLK_SZ * b->n);
-    if (!tmp) return 1;
-    free(b->data);
-    b->data = tmp;
-    b->n = 1;
-    b->data[0] = 0;
-    return 0;
+    _bint_tmp_release(pos);
 }
 
-bigint* BINT_divmod(bigint* n, const bigint* div) {
-    if (BINT_iszero(div)) return NULL;
-    bigint* d = BINT_cp(div);
-    size_t shift = 0;
-    while (BINT_cmp(n, d) > 0) {
-        BINT_shl1(d);
-        shift++;
-    }
-    bigint* result = BINT_make();
-    while (1) {
-        if (BINT_cmp(n, d) >= 0) {
-            BINT_set_bit_at(result, shift, true);
-            BINT_sub_from(n, d);
+BINT_AVX512 void _bint_soa_montmul_avx512(uint64_t* rp, const uint64_t* ap,
+                                          const uint64_t* bp,
+                                          const uint64_t* mp,
+                                          const uint64_t* mi, size_t n,
+                                          size_t stride) {
+    const __m512i lo32 = _mm512_set1_epi64(UINT32_MAX);
+    const __m512i zero = _mm512_setzero_si512();
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    uint64_t* q = (uint64_t*)_bint_tmp_alloc(sizeof(__m512i) * n);
+    for (size_t g = 0; g < stride; g += 8) {
+        const uint64_t *a = ap + g, *b = bp + g, *m = mp + g;
+        __m512i lo = zero, hi, p;
+        for (size_t k = 0; k < 2 * n - 1; k++) {
+            size_t i0 = k >= n ? k - n + 1 : 0, i1 = MIN(k + 1, n);
+            hi = zero;
+            for (size_t i = i0; i < i1; i++) {
+                p = _mm512_mul_epu32(V5_LD(a + i * stride),
+                                     V5_LD(b + (k - i) * stride));
+                lo = _mm512_add_epi64(lo, _mm512_and_si512(p, lo32));
+                hi = _mm512_add_epi64(hi, _mm512_srli_epi64(p, 32));
+                if (i < k) {
+                    p = _mm512_mul_epu32(V5_LD(q + 8 * i),
+                                         V5_LD(m + (k - i) * stride));
+                    lo = _mm512_add_epi64(lo, _mm512_and_si512(p, lo32));
+                    hi = _mm512_add_epi64(hi, _mm512_srli_epi64(p, 32));
+                }
+            }
+            if (k < n) {
+                __m512i qk = _mm512_and_si512(
+                    _mm512_mul_epu32(lo, V5_LD(mi + g)), lo32);
+                V5_ST(q + 8 * k, qk);
+                p = _mm512_mul_epu32(qk, V5_LD(m));
+                lo = _mm512_add_epi64(lo, _mm512_and_si512(p, lo32));
+                hi = _mm512_add_epi64(hi, _mm512_srli_epi64(p, 32));
+            } else {
+                V5_ST(rp + (k - n) * stride + g, _mm512_and_si512(lo, lo32));
+            }
+            lo = _mm512_add_epi64(_mm512_srli_epi64(lo, 32), hi);
+        }
+        V5_ST(rp + (n - 1) * stride + g, _mm512_and_si512(lo, lo32));
+        // as in the AVX2 version, with the lanes to subtract in a mask
+        __m512i d, borrow = zero;
+        for (size_t j = 0; j < n; j++) {
+            d = _mm512_sub_epi64(V5_LD(rp + j * stride + g),
+                                 V5_LD(m + j * stride));
+            borrow = _mm512_srli_epi64(_mm512_sub_epi64(d, borrow), 63);
+        }
+        __mmask8 sel = _mm512_cmpneq_epi64_mask(_mm512_srli_epi64(lo, 32),
+                                                zero) |
+                       _mm512_cmpeq_epi64_mask(borrow, zero);
+        borrow = zero;
+        for (size_t j = 0; j < n; j++) {
+            __m512i r = V5_LD(rp + j * stride + g);
+            d = _mm512_sub_epi64(_mm512_sub_epi64(r, V5_LD(m + j * stride)),
+                                 borrow);
+            borrow = _mm512_srli_epi64(d, 63);
+            V5_ST(rp + j * stride + g,
+                  _mm512_mask_and_epi64(r, sel, d, lo32));
         }
-        BINT_shr1(d);
-        if (shift == 0) break;
-        shift--;
     }
-    BINT_rlz(n);
-    BINT_rlz(result);
-    BINT_free(d);
-    return result;
+    _bint_tmp_release(pos);
 }
 
-int BINT_multo_imm(bigint* b, uint32_t imm) {
-    bint_blk_type carry = 0;
-    uint64_t tmp;
-    for (size_t i = 0; i < b->n; i++) {
-        tmp = (uint64_t)b->data[i] * imm + carry;
+#ifndef BINT_BLK_64
+
+// addmul_1 multiplies the even and the odd blocks of a vector in separate
+// 64-bit lanes, each product with its rp block added (which cannot
+// overflow). The low halves are the new blocks in place, and the high
+// halves are added to the next block up, so one carry-propagating add per
+// vector finishes the row.
+
+static inline bint_blk_type _bint_addmul_1_tail(bint_blk_type* rp,
+                                                const bint_blk_type* ap,
+                                                size_t n, bint_blk_type m,
+                                                bint_blk_type carry) {
+    bint_dblk_type tmp;
+    for (size_t i = 0; i < n; i++) {
+        tmp = (bint_dblk_type)ap[i] * m + rp[i] + carry;
         carry = tmp >> BINT_BLK_BIT_SZ;
-        b->data[i] = (bint_blk_type)tmp;
-    }
-    if (carry) {
-        BINT_REALLOC(b, b->n + 1);
-        b->data[b->n - 1] = carry;
+        rp[i] = (bint_blk_type)tmp;
     }
-    return 0;
+    return carry;
 }
 
-int BINT_mul(const bigint* l, const bigint* r, bigint* res) {
-    if (res->data) free(res->data);
-    _bint_init_with_size(res, l->n + r->n, NULL);
-    memset(res->data, 0, BINT_BLK_SZ * res->n);
-    if (BINT_isneg(l) ^ BINT_isneg(r)) {
-        BINT_neg(res);
-    }
-
-    const bigint* big = (l->n >= r->n) ? l : r;
-    const bigint* small = (big == l) ? r : l;
+/// rp[0..n) += ap[0..n) * m. Returns the carry block.
+BINT_AVX2 bint_blk_type _bint_addmul_1_avx2(bint_blk_type* rp,
+                                            const bint_blk_type* ap, size_t n,
+                                            bint_blk_type m) {
+    const __m256i mv = _mm256_set1_epi64x(m);
+    const __m256i lo32 = _mm256_set1_epi64x(0xffffffff);
+    const __m256i sign = V2_SET1(BINT_BLK_HIGHEST_BIT);
+    const __m256i ones = V2_SET1(BINT_BLK_MAX);
+    const __m256i idx = V2_LANE_IDX;
+    const __m256i up = _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6);
+    // block 0 of hp is the high half carried in from the last vector
+    __m256i hp = _mm256_setzero_si256();
+    unsigned c = 0, g, p, cm;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(ap + i));
+        __m256i r = _mm256_loadu_si256((const __m256i*)(rp + i));
+        __m256i pe = _mm256_add_epi64(_mm256_mul_epu32(a, mv),
+                                      _mm256_and_si256(r, lo32));
+        __m256i po = _mm256_add_epi64(
+            _mm256_mul_epu32(_mm256_srli_epi64(a, 32), mv),
+            _mm256_srli_epi64(r, 32));
+        __m256i l = _mm256_blend_epi32(pe, _mm256_slli_epi64(po, 32), 0xaa);
+        __m256i po_up = _mm256_permutevar8x32_epi32(po, up);
+        __m256i h = _mm256_blend_epi32(_mm256_blend_epi32(po_up, hp, 0x01),
+                                       pe, 0xaa);
+        hp = po_up;
+        __m256i s = _mm256_add_epi32(l, h);
+        g = V2_MOVEMASK(V2_CMPGT(_mm256_xor_si256(l, sign),
+                                 _mm256_xor_si256(s, sign)));
+        p = V2_MOVEMASK(V2_CMPEQ(s, ones));
+        cm = _bint_carry_mask(g, p, &c, 8);
+        __m256i inc = _mm256_and_si256(V2_SRLV(V2_SET1(cm), idx), V2_SET1(1));
+        _mm256_storeu_si256((__m256i*)(rp + i), V2_ADD(s, inc));
+    }
+    bint_blk_type carry =
+        (bint_blk_type)_mm256_cvtsi256_si32(hp) + c;
+    return _bint_addmul_1_tail(rp + i, ap + i, n - i, m, carry);
+}
 
-    bint_blk_type* buf = (bint_blk_type*)malloc(BINT_BLK_SZ * (big->n + 1));
+/// rp[0..n) += ap[0..n) * m. Returns the carry block.
+BINT_AVX512 bint_blk_type _bint_addmul_1_avx512(bint_blk_type* rp,
+                                                const bint_blk_type* ap,
+                                                size_t n, bint_blk_type m) {
+    const __m512i mv = _mm512_set1_epi64(m);
+    const __m512i lo32 = _mm512_set1_epi64(0xffffffff);
+    const __m512i ones = V5_SET1(BINT_BLK_MAX);
+    // block 15 of po is the high half carried into the next vector
+    __m512i po = _mm512_setzero_si512();
+    unsigned c = 0, g, p, cm;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i a = _mm512_loadu_si512((const void*)(ap + i));
+        __m512i r = _mm512_loadu_si512((const void*)(rp + i));
+        __m512i pe = _mm512_add_epi64(_mm512_mul_epu32(a, mv),
+                                      _mm512_and_si512(r, lo32));
+        __m512i last = po;
+        po = _mm512_add_epi64(_mm512_mul_epu32(_mm512_srli_epi64(a, 32), mv),
+                              _mm512_srli_epi64(r, 32));
+        __m512i l =
+            _mm512_mask_blend_epi32(0xaaaa, pe, _mm512_slli_epi64(po, 32));
+        __m512i h = _mm512_mask_blend_epi32(
+            0xaaaa, _mm512_alignr_epi32(po, last, 15), pe);
+        __m512i s = _mm512_add_epi32(l, h);
+        g = _mm512_cmplt_epu32_mask(s, l);
+        p = _mm512_cmpeq_epi32_mask(s, ones);
+        cm = _bint_carry_mask(g, p, &c, 16);
+        s = _mm512_mask_sub_epi32(s, cm, s, ones);
+        _mm512_storeu_si512((void*)(rp + i), s);
+    }
+    bint_blk_type carry =
+        (bint_blk_type)_mm512_cvtsi512_si32(_mm512_alignr_epi32(po, po, 15)) +
+        c;
+    return _bint_addmul_1_tail(rp + i, ap + i, n - i, m, carry);
+}
 
-    size_t i, j, k, res_idx;
-    bint_blk_type carry_mult, carry_add;
+// The multiplications work by output columns, one column per 64-bit lane.
+// Each 32x32-bit product is split into its low half, added to the lane of
+// its own column, and its high half, added to the lane of the next one, so
+// the lanes cannot overflow and the carries are propagated once at the end.
 
-    __m256i m;
-    const __m256i masklo = _mm256_set1_epi64x(UINT32_MAX);
-    // const __m256i maskhi = _mm256_set1_epi64x(0xFFFFFFFF00000000);
-    // uint32_t tmp_res[8], tmp_carry[8];
-    uint64_t tmp_res[8];
-    uint64_t tmp;
-
-    // multiplier loop
-    for (i = 0; i < small->n; i++) {
-        carry_mult = 0;
-        for (j = 0; j < big->n; j += 8) {
-            m = _mm256_set1_epi64x(small->data[i]);
-            __m256i v = _mm256_loadu_si256((__m256i*)(big->data + j));
-            __m256i ve = _mm256_srli_epi64(v, 32);
-            __m256i ro = _mm256_mul_epu32(v, m);
-            __m256i re = _mm256_mul_epu32(ve, m);
-
-            // __m256i reres = _mm256_and_si256(re, masklo);
-            // __m256i rores = _mm256_and_si256(_mm256_slli_epi64(ro, 32),
-            // maskhi);
-            // __m256i res =
-            //     _mm256_or_si256(reres, rores);  // the result (low 32 bit)
-
-            // __m256i recarry = _mm256_srli_epi64(re, 32);
-            // __m256i rocarry = _mm256_and_si256(ro, maskhi);
-            // __m256i carry =
-            //     _mm256_or_si256(recarry, rocarry);  // the result (high 32
-            //     bit)
-
-            // _mm256_storeu_si256((__m256i*)tmp_res, res);
-            // _mm256_storeu_si256((__m256i*)tmp_carry, carry);
-
-            tmp_res[0] = ro[0];
-            tmp_res[2] = ro[1];
-            tmp_res[4] = ro[2];
-            tmp_res[6] = ro[3];
-            tmp_res[1] = re[0];
-            tmp_res[3] = re[1];
-            tmp_res[5] = re[2];
-            tmp_res[7] = re[3];
-
-            for (k = 0; k < 8 && (j + k < big->n); k++) {
-                tmp = tmp_res[k] + carry_mult;
-                buf[j + k] = (bint_blk_type)tmp;
-                carry_mult = tmp >> BINT_BLK_BIT_SZ;
-            }
-        }
-        buf[big->n] = carry_mult;
-
-        carry_add = 0;
-        for (res_idx = i, j = 0; j < big->n + 1; res_idx += 8, j += 8) {
-            __m256i ao = _mm256_loadu_si256((__m256i*)(res->data + res_idx));
-            __m256i bo = _mm256_loadu_si256((__m256i*)(buf + j));
-            __m256i ae = _mm256_srli_epi64(ao, 32);
-            __m256i be = _mm256_srli_epi64(bo, 32);
-            ao = _mm256_and_si256(ao, masklo);
-            bo = _mm256_and_si256(bo, masklo);
-
-            __m256i sume = _mm256_add_epi64(ae, be);
-            __m256i sumo = _mm256_add_epi64(ao, bo);
-
-            tmp_res[0] = sumo[0];
-            tmp_res[2] = sumo[1];
-            tmp_res[4] = sumo[2];
-            tmp_res[6] = sumo[3];
-            tmp_res[1] = sume[0];
-            tmp_res[3] = sume[1];
-            tmp_res[5] = sume[2];
-            tmp_res[7] = sume[3];
-
-            for (k = 0; k < 8 && (j + k < big->n + 1); k++) {
-                tmp = tmp_res[k] + carry_add;
-                res->data[res_idx + k] = (bint_blk_type)tmp;
-                carry_add = tmp >> BINT_BLK_BIT_SZ;
-            }
-        }
-        res->data[i + big->n] += carry_add;
+/// Propagates the carries of the column sums col[0..n) into rp[0..n).
+static inline void _bint_mul_cols_norm(bint_blk_type* rp, const uint64_t* col,
+                                       size_t n) {
+    uint64_t t, carry = 0;
+    for (size_t c = 0; c < n; c++) {
+        t = col[c] + carry;
+        rp[c] = (bint_blk_type)t;
+        carry = t >> BINT_BLK_BIT_SZ;
     }
-    free(buf);
-    return BINT_rlz(res);
 }
 
-int BINT_addto_imm(bigint* b, uint32_t imm) {
-    if (!b->n) return 1;
-    uint64_t tmp = (uint64_t)b->data[0] + imm;
-    b->data[0] = (bint_blk_type)tmp;
-    bint_blk_type carry = tmp >> BINT_BLK_BIT_SZ;
-    for (size_t i = 1; i < b->n; i++) {
-        tmp = (uint64_t)b->data[i] + carry;
-        carry = tmp >> BINT_BLK_BIT_SZ;
-        b->data[i] = (bint_blk_type)tmp;
-    }
-    if (carry) {
-        BINT_REALLOC(b, b->n + 1);
-        b->data[b->n - 1] = carry;
-    }
-    return 0;
-}
+/// Schoolbook multiplication. rp[0..an+bn) = ap[0..an) * bp[0..bn).
+BINT_AVX2 void _bint_mul_basecase_avx2(bint_blk_type* rp,
+                                       const bint_blk_type* ap, size_t an,
+                                       const bint_blk_type* bp, size_t bn) {
+    // ap is read through a copy with 8 zero blocks on both sides, so the
+    // windows of a column block never go out of bounds
+    size_t cn = an + bn;
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    bint_blk_type* az =
+        (bint_blk_type*)_bint_tmp_alloc(BINT_BLK_SZ * (an + 16));
+    uint64_t* col = (uint64_t*)_bint_tmp_alloc(sizeof(uint64_t) * (cn + 9));
+    memset(az, 0, BINT_BLK_SZ * (an + 16));
+    memset(col, 0, sizeof(uint64_t) * (cn + 9));
+    const bint_blk_type* A = az + 8;
+    memcpy(az + 8, ap, BINT_BLK_SZ * an);
 
-int BINT_add(const bigint* l, const bigint* r, bigint* res) {
-    free(res->data);
-
-    bint_blk_type carry = 0;
-    uint64_t tmp;
-    const bigint* big = (l->n >= r->n) ? l : r;
-    const bigint* small = (big == l) ? r : l;
-    bint_blk_type* buf = (bint_blk_type*)malloc(BINT_BLK_SZ * (big->n + 1));
-    // TODO: negative
-    if (!buf) {
-        return 1;
-    }
-    size_t i = 0;
-    for (; i < small->n; i++) {
-        tmp = (uint64_t)big->data[i] + small->data[i] + carry;
-        carry = tmp >> BINT_BLK_BIT_SZ;
-        buf[i] = (bint_blk_type)tmp;
-    }
-    for (; i < big->n; i++) {
-        tmp = (uint64_t)big->data[i] + carry;
-        if (tmp > BINT_BLK_MAX) {
-            carry = tmp >> BINT_BLK_BIT_SZ;
+    const __m256i masklo = _mm256_set1_epi64x(UINT32_MAX);
+    size_t i, k, i0, i1;
+    for (k = 0; k < cn; k += 8) {
+        __m256i l0 = _mm256_setzero_si256(), l1 = l0, h0 = l0, h1 = l0;
+        // the rows that reach columns k..k+7
+        i0 = k >= an ? k - an + 1 : 0;
+        i1 = MIN(bn, k + 8);
+        for (i = i0; i < i1; i++) {
+            const bint_blk_type* w = A + k - i;
+            __m256i m = _mm256_set1_epi64x(bp[i]);
+            __m256i p0 = _mm256_mul_epu32(
+                _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i*)w)), m);
+            __m256i p1 = _mm256_mul_epu32(
+                _mm256_cvtepu32_epi64(
+                    _mm_loadu_si128((const __m128i*)(w + 4))),
+                m);
+            l0 = _mm256_add_epi64(l0, _mm256_and_si256(p0, masklo));
+            h0 = _mm256_add_epi64(h0, _mm256_srli_epi64(p0, 32));
+            l1 = _mm256_add_epi64(l1, _mm256_and_si256(p1, masklo));
+            h1 = _mm256_add_epi64(h1, _mm256_srli_epi64(p1, 32));
         }
-        buf[i] = (bint_blk_type)tmp;
-    }
-    res->n = big->n;
-    if (carry > 0) {
-        buf[i] = carry;
-        res->n++;
-    }
-    res->data = buf;
-    return 0;
+        __m256i* c0 = (__m256i*)(col + k);
+        __m256i* c1 = (__m256i*)(col + k + 4);
+        _mm256_storeu_si256(c0, _mm256_add_epi64(_mm256_loadu_si256(c0), l0));
+        _mm256_storeu_si256(c1, _mm256_add_epi64(_mm256_loadu_si256(c1), l1));
+        c0 = (__m256i*)(col + k + 1);
+        c1 = (__m256i*)(col + k + 5);
+        _mm256_storeu_si256(c0, _mm256_add_epi64(_mm256_loadu_si256(c0), h0));
+        _mm256_storeu_si256(c1, _mm256_add_epi64(_mm256_loadu_si256(c1), h1));
+    }
+    _bint_mul_cols_norm(rp, col, cn);
+    _bint_tmp_release(pos);
 }
 
-int BINT_sub_from(bigint* a, const bigint* b) {
-    bint_blk_type borrow = 0;
-    bint_blk_type tmp;
-    for (size_t i = 0; i < b->n; i++) {
-        if (b->data[i] || borrow) {
-            tmp = a->data[i] - b->data[i] - borrow;
-            borrow = tmp >= a->data[i];
-            a->data[i] = tmp;
+/// Schoolbook multiplication. rp[0..an+bn) = ap[0..an) * bp[0..bn).
+BINT_AVX512 void _bint_mul_basecase_avx512(bint_blk_type* rp,
+                                           const bint_blk_type* ap, size_t an,
+                                           const bint_blk_type* bp,
+                                           size_t bn) {
+    size_t cn = an + bn;
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    bint_blk_type* az =
+        (bint_blk_type*)_bint_tmp_alloc(BINT_BLK_SZ * (an + 32));
+    uint64_t* col = (uint64_t*)_bint_tmp_alloc(sizeof(uint64_t) * (cn + 17));
+    memset(az, 0, BINT_BLK_SZ * (an + 32));
+    memset(col, 0, sizeof(uint64_t) * (cn + 17));
+    const bint_blk_type* A = az + 16;
+    memcpy(az + 16, ap, BINT_BLK_SZ * an);
+
+    const __m512i masklo = _mm512_set1_epi64(UINT32_MAX);
+    size_t i, k, i0, i1;
+    for (k = 0; k < cn; k += 16) {
+        __m512i l0 = _mm512_setzero_si512(), l1 = l0, h0 = l0, h1 = l0;
+        i0 = k >= an ? k - an + 1 : 0;
+        i1 = MIN(bn, k + 16);
+        for (i = i0; i < i1; i++) {
+            const bint_blk_type* w = A + k - i;
+            __m512i m = _mm512_set1_epi64(bp[i]);
+            __m512i p0 = _mm512_mul_epu32(
+                _mm512_cvtepu32_epi64(_mm256_loadu_si256((const __m256i*)w)),
+                m);
+            __m512i p1 = _mm512_mul_epu32(
+                _mm512_cvtepu32_epi64(
+                    _mm256_loadu_si256((const __m256i*)(w + 8))),
+                m);
+            l0 = _mm512_add_epi64(l0, _mm512_and_si512(p0, masklo));
+            h0 = _mm512_add_epi64(h0, _mm512_srli_epi64(p0, 32));
+            l1 = _mm512_add_epi64(l1, _mm512_and_si512(p1, masklo));
+            h1 = _mm512_add_epi64(h1, _mm512_srli_epi64(p1, 32));
         }
-    }
-    for (size_t i = b->n; borrow != 0; i++) {
-        borrow = a->data[i] == 0;
-        a->data[i]--;
-    }
-    return 0;
+        uint64_t* c = col + k;
+        _mm512_storeu_si512(c, _mm512_add_epi64(_mm512_loadu_si512(c), l0));
+        _mm512_storeu_si512(c + 8,
+                            _mm512_add_epi64(_mm512_loadu_si512(c + 8), l1));
+        _mm512_storeu_si512(c + 1,
+                            _mm512_add_epi64(_mm512_loadu_si512(c + 1), h0));
+        _mm512_storeu_si512(c + 9,
+                            _mm512_add_epi64(_mm512_loadu_si512(c + 9), h1));
+    }
+    _bint_mul_cols_norm(rp, col, cn);
+    _bint_tmp_release(pos);
 }
 
-int BINT_set_bit_at(bigint* bi, size_t idx, bool set) {
-    size_t blk_idx = idx / BINT_BLK_BIT_SZ;
-    size_t blk_off = idx % BINT_BLK_BIT_SZ;
-    if (bi->n <= blk_idx) {
-        size_t orig_size = bi->n;
-        BINT_REALLOC(bi, blk_idx + 1);
-
-        for (size_t i = orig_size; i < bi->n; i++) {
-            bi->data[i] = 0;
+#endif
+
+// The IFMA multiplication works in radix 2^52. vpmadd52luq/huq add the low
+// and high 52 bits of a 52x52-bit product to a 64-bit lane, so as with the
+// kernels above every column is summed in its own lane and the carries are
+// left for one pass at the end. The lanes are emptied every BINT_IFMA_ROWS
+// rows, before they can overflow.
+
+#define BINT_IFMA_MASK ((1ull << 52) - 1)
+#define BINT_IFMA_ROWS 4096
+
+// Two 52-bit digits are 13 bytes, so the conversions go a pair of digits
+// at a time, through two 8-byte words at byte offset 13 * pair. The last
+// pairs, whose words would run past the end, go through a local buffer.
+
+/// Splits ap[0..an) into nd 52-bit digits, written to dp.
+static void _bint_to_52(uint64_t* dp, size_t nd, const bint_blk_type* ap,
+                        size_t an) {
+    const uint8_t* bytes = (const uint8_t*)ap;
+    size_t nbytes = BINT_BLK_SZ * an, j = 0, o;
+    uint8_t tail[16];
+    uint64_t w[2];
+    for (; j < nd; j += 2) {
+        o = 13 * (j >> 1);
+        if (o + sizeof(w) <= nbytes) {
+            memcpy(w, bytes + o, sizeof(w));
+        } else {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, bytes + o, nbytes - o);
+            memcpy(w, tail, sizeof(w));
+        }
+        dp[j] = w[0] & BINT_IFMA_MASK;
+        if (j + 1 < nd) {
+            dp[j + 1] = ((w[0] >> 52) | (w[1] << 12)) & BINT_IFMA_MASK;
         }
     }
-    if (set) {
-        bi->data[blk_idx] |= 1u << blk_off;
-    } else {
-        bi->data[blk_idx] &= ~(1u << blk_off);
-    }
-    return 0;
 }
 
-char* BINT_itoa(const bigint* bi) {
-    if (!bi || !bi->n) return NULL;
-    strbuf* sb = STRBUF_new();
-    bigint* ten = BINT_makeui(10u);
-
-    bigint* bicp = BINT_cp(bi);
-    bigint* next;
-    char digit;
-    while (1) {
-        next = BINT_divmod(bicp, ten);
-        digit = ((bicp->n > 0) ? bicp->data[0] : 0) + '0';
-        STRBUF_pushback(sb, digit);
-        BINT_free(bicp);
-        bicp = next;
-        if (BINT_iszero(bicp)) break;
-    }
-    BINT_free(bicp);
-    BINT_free(ten);
-    if (BINT_isneg(bi)) {
-        STRBUF_pushback(sb, '-');
+/// Packs the 52-bit digits dp[0..nd) into rp[0..rn). The digits past the
+/// end of rp must be zero.
+static void _bint_from_52(bint_blk_type* rp, size_t rn, const uint64_t* dp,
+                          size_t nd) {
+    uint8_t* bytes = (uint8_t*)rp;
+    size_t nbytes = BINT_BLK_SZ * rn, j = 0, o = 0;
+    uint64_t d1, w[2];
+    memset(rp, 0, nbytes);
+    for (; j < nd && o < nbytes; j += 2) {
+        d1 = j + 1 < nd ? dp[j + 1] : 0;
+        w[0] = dp[j] | (d1 << 52);
+        w[1] = d1 >> 12;
+        // the top 3 bytes of w[1] are zero, and overlap the next pair
+        if (o + sizeof(w) <= nbytes) {
+            memcpy(bytes + o, w, sizeof(w));
+        } else {
+            memcpy(bytes + o, w, nbytes - o);
+        }
+        o += 13;
     }
-    STRBUF_reverse(sb);
+}
 
-    char* res = STRBUF_tocstr(sb);
-    STRBUF_free(sb);
-    return res;
+/// Adds the lane sums l (of the columns c..c+7) and h (of c+1..c+8) into
+/// the column arrays, split at 52 bits. cp[c] gets the part of column c,
+/// cq[c] of column c + 1 and cr[c] of column c + 2. Keeping them apart
+/// means the stores never overlap a later load at a different offset.
+BINT_IFMA static inline void _bint_ifma_flush(uint64_t* cp, uint64_t* cq,
+                                              uint64_t* cr, __m512i l,
+                                              __m512i h) {
+    const __m512i mask = _mm512_set1_epi64(BINT_IFMA_MASK);
+    __m512i lo = _mm512_and_si512(l, mask);
+    __m512i mid = _mm512_add_epi64(_mm512_srli_epi64(l, 52),
+                                   _mm512_and_si512(h, mask));
+    __m512i hi = _mm512_srli_epi64(h, 52);
+    _mm512_storeu_si512(cp, _mm512_add_epi64(_mm512_loadu_si512(cp), lo));
+    _mm512_storeu_si512(cq, _mm512_add_epi64(_mm512_loadu_si512(cq), mid));
+    _mm512_storeu_si512(cr, _mm512_add_epi64(_mm512_loadu_si512(cr), hi));
 }
 
-bigint* BINT_atoi(const char* s) {
-    bigint* bi = BINT_zero();
-    char* str = (char*)s;
-    if (str[0] == '-') {
-        BINT_neg(bi);
-        str++;
-    }
-    size_t len = strlen(str);
-    size_t numblk = len / 9 + 1;
-    int err;
-    char buf[10];
-    buf[9] = 0;
-    uint32_t tmp;
-    for (size_t i = 0;; i++) {
-        strncpy(buf, str + (i * 9), 9);
-        tmp = atoi(buf);
-        err = BINT_addto_imm(bi, tmp);
-
-        if (err) goto ERROR;
-        if (i + 1 >= numblk) break;
-
-        if (i + 2 >= numblk)
-            err =
-                BINT_multo_imm(bi, _bint_10_exp(len % 9 == 0 ? 9 : (len % 9)));
-        else
-            err = BINT_multo_imm(bi, 1000000000u);
-        if (err) goto ERROR;
+/// Schoolbook multiplication. rp[0..an+bn) = ap[0..an) * bp[0..bn).
+BINT_IFMA void _bint_mul_basecase_ifma(bint_blk_type* rp,
+                                       const bint_blk_type* ap, size_t an,
+                                       const bint_blk_type* bp, size_t bn) {
+    size_t na = (BINT_BLK_BIT_SZ * an + 51) / 52;
+    size_t nb = (BINT_BLK_BIT_SZ * bn + 51) / 52;
+    size_t cn = na + nb;
+    // the digits of a get 32 zeros on both sides, so the windows of a
+    // column block never go out of bounds
+    size_t sz = sizeof(uint64_t) * (na + 64 + nb + 3 * (cn + 34));
+    _bint_tmp_pos pos = _bint_tmp_mark();
+    uint64_t* az = (uint64_t*)_bint_tmp_alloc(sz);
+    memset(az, 0, sz);
+    uint64_t* bd = az + na + 64;
+    // cq and cr are read from 1 and 2 below, which are left zero
+    uint64_t* cp = bd + nb;
+    uint64_t* cq = cp + cn + 34;
+    uint64_t* cr = cq + cn + 34;
+    const uint64_t* A = az + 32;
+    _bint_to_52(az + 32, na, ap, an);
+    _bint_to_52(bd, nb, bp, bn);
+
+    size_t i, k, i0, i1, ie;
+    for (k = 0; k < cn; k += 32) {
+        // the rows that reach columns k..k+31
+        i0 = k >= na ? k - na + 1 : 0;
+        i1 = MIN(nb, k + 32);
+        for (i = i0; i < i1; i = ie) {
+            __m512i l0 = _mm512_setzero_si512(), l1 = l0, l2 = l0, l3 = l0;
+            __m512i h0 = l0, h1 = l0, h2 = l0, h3 = l0;
+            ie = MIN(i1, i + BINT_IFMA_ROWS);
+            for (; i < ie; i++) {
+                const uint64_t* w = A + k - i;
+                __m512i m = _mm512_set1_epi64(bd[i]);
+                __m512i w0 = _mm512_loadu_si512(w);
+                __m512i w1 = _mm512_loadu_si512(w + 8);
+                __m512i w2 = _mm512_loadu_si512(w + 16);
+                __m512i w3 = _mm512_loadu_si512(w + 24);
+                l0 = _mm512_madd52lo_epu64(l0, w0, m);
+                h0 = _mm512_madd52hi_epu64(h0, w0, m);
+                l1 = _mm512_madd52lo_epu64(l1, w1, m);
+                h1 = _mm512_madd52hi_epu64(h1, w1, m);
+                l2 = _mm512_madd52lo_epu64(l2, w2, m);
+                h2 = _mm512_madd52hi_epu64(h2, w2, m);
+                l3 = _mm512_madd52lo_epu64(l3, w3, m);
+                h3 = _mm512_madd52hi_epu64(h3, w3, m);
+            }
+            _bint_ifma_flush(cp + k, cq + k, cr + k, l0, h0);
+            _bint_ifma_flush(cp + k + 8, cq + k + 8, cr + k + 8, l1, h1);
+            _bint_ifma_flush(cp + k + 16, cq + k + 16, cr + k + 16, l2, h2);
+            _bint_ifma_flush(cp + k + 24, cq + k + 24, cr + k + 24, l3, h3);
+        }
     }
-    return bi;
-
-ERROR:
-    BINT_free(bi);
-    return NULL;
-}
 
-inline void _bint_init_with_size(bigint* bi, size_t n, void* val) {
-    bi->n = n;
-    bi->flags = 0;
-    bi->data = (bint_blk_type*)malloc(n * BINT_BLK_SZ);
-    if (val != NULL) {
-        memcpy(bi->data, val, n * BINT_BLK_SZ);
+    // the normalization pass, with the digits of the product going to cp
+    uint64_t t, carry = 0;
+    for (k = 0; k < cn; k++) {
+        t = cp[k] + cq[k - 1] + cr[k - 2] + carry;
+        cp[k] = t & BINT_IFMA_MASK;
+        carry = t >> 52;
     }
+    _bint_from_52(rp, an + bn, cp, cn);
+    _bint_tmp_release(pos);
 }
+
+#endif